@@ -0,0 +1,48 @@
+#include <flipper_application/flipper_application.h>
+
+#include "box_ai.h"
+
+// Pressure fighter: follows a dodging player and throws as soon as it is allowed to,
+// at half the boss table's delays
+typedef struct {
+    uint32_t next_ms;
+} RushState;
+
+static void rush_init(void* state, uint32_t now_ms) {
+    ((RushState*)state)->next_ms = now_ms;
+}
+
+static void rush_hold(void* state, uint32_t until_ms) {
+    ((RushState*)state)->next_ms = until_ms;
+}
+
+static void rush_step(void* state, const BoxAiObs* obs, const BoxAiOps* ops, void* ctx) {
+    RushState* s = state;
+    if((uint32_t)(obs->now_ms - s->next_ms) >= 0x80000000u || obs->enemy_state != BoxAiIdle) return;
+    if(obs->dx > obs->punch_range) {
+        ops->shuffle(ctx, (obs->player_x > obs->enemy_x) ? +1 : -1);
+        s->next_ms = obs->now_ms + 120;
+        return;
+    }
+    ops->telegraph(ctx);
+    s->next_ms = obs->now_ms + obs->ai_base_delay / 2 + ops->rand(ctx) % (obs->ai_rand_delay / 2 + 1);
+}
+
+static const BoxAiBackend rush = {
+    .name = "RUSH",
+    .budget_cycles = 400,
+    .state_size = sizeof(RushState),
+    .init = rush_init,
+    .hold = rush_hold,
+    .step = rush_step,
+};
+
+static const FlipperAppPluginDescriptor rush_descriptor = {
+    .appid = BOX_AI_APPID,
+    .ep_api_version = BOX_AI_API_VERSION,
+    .entry_point = &rush,
+};
+
+const FlipperAppPluginDescriptor* box_ai_rush_ep(void) {
+    return &rush_descriptor;
+}
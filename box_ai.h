@@ -0,0 +1,63 @@
+#pragma once
+
+// Boss AI backend interface, shared by the game and AI plugins (.fal).
+// A plugin exports a FlipperAppPluginDescriptor with appid BOX_AI_APPID, ep_api_version
+// BOX_AI_API_VERSION and a BoxAiBackend as its entry point; the plugin manager refuses any other version.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BOX_AI_APPID "box_flipper_ai"
+#define BOX_AI_API_VERSION 1
+// Private state the game keeps per fight for a backend, 4-byte aligned
+#define BOX_AI_STATE_MAX 32
+
+// Fighter states as seen in an observation
+typedef enum {
+    BoxAiIdle = 0,
+    BoxAiTelegraph,
+    BoxAiPunching,
+    BoxAiHitStun,
+    BoxAiDodging,
+    BoxAiKO,
+} BoxAiFighterState;
+
+// Read-only view of the fight, refreshed by the game after every action a backend takes
+typedef struct {
+    uint32_t now_ms;
+    uint8_t boss;
+    uint8_t player_state;
+    uint8_t enemy_state;
+    uint8_t player_hp;
+    uint8_t enemy_hp;
+    bool enemy_open;
+    int16_t player_x;
+    int16_t enemy_x;
+    uint16_t dx;
+    uint16_t punch_range;
+    // This boss's row of the boss table
+    uint8_t punch_chance_near;
+    uint8_t punch_chance_far;
+    uint16_t ai_base_delay;
+    uint16_t ai_rand_delay;
+    uint16_t telegraph_ms;
+} BoxAiObs;
+
+// Everything a backend can do to the fight. Actions are ignored unless the boss is idle.
+typedef struct {
+    uint32_t (*rand)(void* ctx); // the fight's own random stream, keeps replays deterministic
+    void (*telegraph)(void* ctx); // flash, then punch
+    void (*shuffle)(void* ctx, int8_t dir); // one step left (-1) or right (+1)
+} BoxAiOps;
+
+typedef struct {
+    const char* name;
+    uint32_t budget_cycles; // per step, the game profiles every step against it
+    uint16_t state_size; // at most BOX_AI_STATE_MAX
+    // A boss steps into the ring at now_ms
+    void (*init)(void* state, uint32_t now_ms);
+    // Start no action before until_ms (boss intro, fight start)
+    void (*hold)(void* state, uint32_t until_ms);
+    // Every live tick while both fighters are up and no intro or knockdown is playing
+    void (*step)(void* state, const BoxAiObs* obs, const BoxAiOps* ops, void* ctx);
+} BoxAiBackend;
@@ -1,9 +1,20 @@
 #include <furi.h>
+#include <furi_hal.h>
 #include <gui/gui.h>
+#include <gui/canvas_i.h>
 #include <input/input.h>
+#include <notification/notification_messages.h>
+#include <storage/storage.h>
+#include <flipper_application/flipper_application.h>
+#include <flipper_application/plugins/plugin_manager.h>
+#include <loader/firmware_api/firmware_api.h>
+#include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "box_ai.h"
+
 #define SCREEN_W 128
 #define SCREEN_H 64
 
@@ -23,10 +34,23 @@
 
 // Timing (ms)
 #define FRAME_MS 33
+#define TICK_MS 2
 #define HIT_STUN_MS 260
+#define INPUT_LONG_MS 300
+// How far back a press may be judged: a quick tap plus a frame of loop and queue delay
+#define INPUT_RETRO_MS 80
 
 // Movement
 #define PLAYER_DODGE_OFFSET 20
+
+// Visual motion, ms
+#define TWEEN_DODGE_MS 60
+#define TWEEN_RETURN_MS 90
+#define TWEEN_SHUFFLE_MS 120
+#define TWEEN_KNOCK_MS 160
+#define TWEEN_KNOCK_PX 3
+#define TWEEN_LUNGE_PX 3
+#define TWEEN_LUNGE_MS 160
 #define ENEMY_SHUFFLE_RANGE 5
 #define ENEMY_SHUFFLE_STEP  1
 
@@ -34,9 +58,119 @@
 #define MAX_HP 10
 #define PUNCH_RANGE 16
 
+// Knockdown / walk-in sequences
+#define KO_FALL_PX 6
+#define KO_FALL_STEP_MS 40
+#define KO_COUNT_TO 3
+#define KO_COUNT_MS 450
+#define WALK_IN_PX 40
+#define WALK_IN_STEP_MS 30
+
 // Mensajes más rápidos de la versión B
 #define MSG_MS 1500
 
+// Menu rows that fit under the title
+#define MENU_ROWS 4
+
+// Settings file
+#define SETTINGS_PATH APP_DATA_PATH("settings.bin")
+#define SETTINGS_VERSION 4
+#define HITSTOP_FRAMES_MAX 4
+#define HITSTOP_FRAMES_DEFAULT 2
+
+// Latency calibration: tap OK on a flash every CALIB_PERIOD_MS
+#define CALIB_PERIOD_MS 750
+#define CALIB_FLASH_MS 120
+#define CALIB_TAPS 20
+#define CALIB_MIN_TAPS 8
+#define CALIB_MAD_OK_MS 8
+#define CALIB_MAD_K 3
+#define LATENCY_MAX_MS 40
+
+// Power model: charge per counted event in nC, so nC per ms of runtime reads directly as uA.
+// Rough estimates from datasheet figures, not measured: replace them with bench-supply readings
+// (backlight off) before trusting absolute numbers. The base covers MCU + display idle.
+#define POWER_LOG_PATH APP_DATA_PATH("power.log")
+#define POWER_BASE_UA 7800
+#define POWER_WAKEUP_NC 450
+#define POWER_UPDATE_NC 1200
+#define POWER_FRAME_NC 9500
+#define POWER_SD_WRITE_NC 140000
+#define POWER_VIBRO_NC 3900000
+
+// Time attack: best run as seed + inputs, streamed back as a ghost
+#define GHOST_PATH APP_DATA_PATH("best.ghost")
+#define GHOST_MAGIC 0x54534847 // "GHST"
+#define GHOST_VERSION 2
+#define GHOST_CHUNK 32
+#define GHOST_REC_MAX 512
+#define IO_QUEUE_LEN 8
+
+// Lifetime stats: one fixed-size record per boss, updated in place after every bout
+#define LIFETIME_PATH APP_DATA_PATH("lifetime.bin")
+#define LIFETIME_MAGIC 0x4546494C // "LIFE"
+#define LIFETIME_VERSION 1
+#define LIFETIME_BUCKETS 16
+
+// Boss table live reload: bosses.txt is checked by the io worker at most every BOSS_POLL_MS
+#define BOSS_TABLE_PATH APP_DATA_PATH("bosses.txt")
+#define BOSS_TABLE_MAX 768
+// boss_table_err for a file over BOSS_TABLE_MAX, instead of a line number
+#define BOSS_TABLE_TOO_LONG 0xFFFF
+#define BOSS_NAME_MAX 12
+#define BOSS_POLL_MS 1000
+
+// Flight recorder: fighter state changes and inputs of the live fight since a Sim keyframe,
+// dumped to FLIGHT_PATH at exit or when the stuck-state watchdog trips
+#define FLIGHT_PATH APP_DATA_PATH("flight.bin")
+#define FLIGHT_MAGIC 0x31544C46 // "FLT1"
+#define FLIGHT_VERSION 1
+#define FLIGHT_ENTRIES 96
+#define FLIGHT_KEY_TICKS 2048
+// A timed fighter state this far past its deadline is stuck
+#define FLIGHT_STUCK_MS 200
+
+// Boss AI backends: the built-in one plus plugins from the app's assets and from AI_PLUGIN_PATH
+#define AI_PLUGIN_PATH APP_DATA_PATH("ai")
+#define AI_SLOTS_MAX 6
+// Settings keep the picked backend's name, matched on its first AI_NAME_MAX - 1 bytes
+#define AI_NAME_MAX 16
+#define AI_BUILTIN_BUDGET 600
+#define AI_BOUT_MAX_TICKS 60000
+
+// Bot players for soak and bouts. BOT_NONE keeps the old uniform random play.
+#define BOT_NONE 0xFF
+// A bot aims its dodge this long before the punch lands, the middle of the 220 ms dodge
+#define BOT_DODGE_AIM_MS 110
+
+// Cues (sound / vibration). Build with cdefines=["BOX_CUE_LOG"] to log instead of playing
+#define CUE_QUEUE_LEN 8
+#define CUE_STALE_MS 40
+
+// Command channel (tests / tooling). Enable the CDC transport with cdefines=["BOX_CMD_CDC"]
+#define CMD_LINE_MAX 48
+#define CMD_INJECT_MAX 16
+#define CMD_RX_SIZE 256
+#define CMD_CDC_IF 1
+#define CMD_CDC_CHUNK 63
+// Differential runner against the frozen reference core, cdefines=["BOX_DIFF"] on top of BOX_CMD_CDC
+#define REPLAY_INPUTS_MAX 96
+// A replay loaded with "D case" may be a field report: up to this many inputs, in that case only
+#define REPLAY_CASE_MAX 1024
+// Keyframes the minimizer keeps of the accepted case, spread evenly over its ticks
+#define DIFF_KEYS 16
+#define FB_SIZE (SCREEN_W * SCREEN_H / 8)
+
+#define FX_SHAKE_MS 180
+#define FX_SHAKE_PX 2
+#define FX_KO_SHAKE_PX 3
+#define FX_FLASH_MS 90
+// DWT cycle counter, enabled by furi at boot
+#ifndef FX_CYCCNT
+#define FX_CYCCNT (*(volatile uint32_t*)0xE0001004)
+#endif
+#define TERM_OUT_MAX 128
+
 typedef enum {
     FighterStateIdle = 0,
     FighterStateTelegraph,
@@ -46,9 +180,94 @@ typedef enum {
     FighterStateKO,
 } FighterState;
 
+typedef enum {
+    CurveOut, // fast start, cubic settle
+    CurveInOut, // smoothstep
+    CurvePulse, // out and back, half sine
+    CurveCount,
+} Curve;
+
+// Decaying visual offset in Q8.8 px: amp * curve(phase), every curve ends at 0
+typedef struct {
+    int16_t amp;
+    uint8_t curve;
+    uint16_t tick;
+    uint16_t ticks;
+} Tween;
+
+typedef enum {
+    SprPIdle1,
+    SprPIdle2,
+    SprPPunch,
+    SprPDodge,
+    SprB1Idle1, SprB1Idle2, SprB1Punch, SprB1Hurt,
+    SprB2Idle1, SprB2Idle2, SprB2Punch, SprB2Hurt,
+    SprB3Idle1, SprB3Idle2, SprB3Punch, SprB3Hurt,
+    SprCount,
+} SpriteId;
+
+// Boss frames sit in the atlas in this order, one block per boss from SprB1Idle1
+typedef enum {
+    BossPoseIdle1,
+    BossPoseIdle2,
+    BossPosePunch,
+    BossPoseHurt,
+    BossPoseCount,
+} BossPose;
+
+typedef enum {
+    AnimMarkNone,
+    AnimMarkConnect, // fist reaches the target
+} AnimMark;
+
+typedef struct {
+    uint8_t sprite; // SpriteId, or BossPose for per-boss clips
+    int8_t dy;
+    uint16_t ms; // ignored on the last frame of a one-shot, which holds
+    uint8_t mark; // AnimMark, emitted as the frame is entered
+} AnimFrame;
+
+typedef enum {
+    AnimLoop,
+    AnimOnce,
+} AnimMode;
+
+typedef struct {
+    const AnimFrame* frames;
+    uint8_t count;
+    uint8_t mode;
+    bool per_boss;
+} AnimClip;
+
+typedef enum {
+    ClipPIdle,
+    ClipPPunch,
+    ClipPDodge,
+    ClipPHurt,
+    ClipBIdle,
+    ClipBPunch,
+    ClipBHurt,
+    ClipCount,
+} ClipId;
+
+typedef struct {
+    uint8_t clip;
+    uint8_t frame;
+    uint16_t elapsed_ms;
+} Animator;
+
+typedef struct {
+    uint8_t id;
+    uint8_t bits[FIGHTER_H * 2];
+} SpriteCache;
+
 typedef struct {
     int16_t x;
     int16_t y;
+    Animator anim;
+    // Drawn at x/y plus these; hit checks only ever see x/y
+    Tween tx;
+    Tween ty;
     int16_t home_x;
     FighterState state;
     uint32_t state_until_ms;
@@ -74,68 +293,453 @@ typedef struct {
     bool telegraph_hittable;
 } BossDef;
 
+typedef enum {
+    SimFighterPlayer = 0,
+    SimFighterEnemy,
+} SimFighter;
+
+// Every combat mutation is one of these and only sim_apply() changes state for it
+typedef enum {
+    SimEvNewGame = 0,
+    SimEvTelegraph,
+    SimEvPunchStarted,
+    SimEvDodgeStarted,
+    SimEvHitLanded,
+    SimEvBlocked,
+    SimEvWindowOpened,
+    SimEvKO,
+    SimEvBossAdvanced,
+    SimEvMatchWon,
+    SimEvShuffle,
+    SimEvRefCount,
+    SimEvFightStart,
+    SimEvAnimMark,
+    SimEvHitUndone,
+} SimEvType;
+
+typedef struct {
+    uint8_t type;
+    uint8_t who;
+    int16_t arg;
+} SimEvent;
+
+typedef struct Sim Sim;
+typedef void (*SimEventCallback)(void* ctx, const Sim* sim, const SimEvent* ev);
+
+// Protothread-style script: a resume point plus one timer and one counter, no stack of its own
+typedef struct {
+    uint16_t line;
+    uint8_t i;
+    uint32_t wait_until_ms;
+} Script;
+
+typedef bool (*ScriptFn)(Sim* sim);
+
+#define SCRIPT_BEGIN(sc) \
+    switch((sc)->line) { \
+    case 0:
+#define SCRIPT_WAIT_UNTIL(sc, cond) \
+    do { \
+        (sc)->line = __LINE__; \
+        /* fall through */ \
+    case __LINE__: \
+        if(!(cond)) return false; \
+    } while(0)
+#define SCRIPT_WAIT_MS(sc, now, ms) \
+    do { \
+        (sc)->wait_until_ms = (now) + (ms); \
+        SCRIPT_WAIT_UNTIL(sc, time_reached(now, (sc)->wait_until_ms)); \
+    } while(0)
+#define SCRIPT_END(sc) \
+    } \
+    (sc)->line = 0; \
+    return true;
+
+typedef struct {
+    SimEventCallback fn;
+    void* ctx;
+} SimSub;
+
+// A boss AI backend and what its steps have cost so far
+typedef struct {
+    const BoxAiBackend* be;
+    uint32_t steps;
+    uint32_t over; // steps over the backend's budget
+    uint32_t cyc_max;
+    uint64_t cyc_sum;
+} AiSlot;
+
+#define SIM_SUBS_MAX 6
+
+// Combat core: everything needed to step a fight, nothing about GUI or input
+struct Sim {
+    uint32_t tick;
+    uint32_t clock_ms;
+    Fighter player;
+    Fighter enemy;
+    uint8_t boss_index;
+    const BossDef* bosses;
+    uint32_t enemy_vulnerable_until_ms;
+    // Boss AI, NULL for the built-in one unprofiled (replays, soak, ghosts), and its private state
+    AiSlot* ai;
+    uint32_t ai_state[BOX_AI_STATE_MAX / 4];
+    // Running intro / knockdown script, NULL when the fight is live
+    ScriptFn script;
+    Script script_state;
+    uint8_t enemy_fall_px;
+    uint8_t enemy_walk_px;
+    // Hit-stop: while freeze_ticks runs down the clock stands still, so every deadline shifts together
+    uint16_t hitstop_ticks;
+    uint16_t freeze_ticks;
+    // Last enemy hit on the player, so a dodge captured before it can still take it back
+    uint32_t player_hit_ms;
+    bool player_hit_undo;
+    // Per-sim xorshift32, so two sims (or a sim and the reference core) never share a random stream
+    uint32_t rng;
+    SimSub subs[SIM_SUBS_MAX];
+    uint8_t sub_count;
+};
+
+typedef enum {
+    SceneTitle = 0,
+    SceneBossSelect,
+    SceneSettings,
+    SceneStats,
+    SceneFight,
+    SceneCalib,
+    SceneCount,
+} SceneId;
+
+// Menu scenes keep nothing but a cursor, allocated on enter and freed on exit
+typedef struct {
+    uint8_t cursor;
+} SceneMenu;
+
+typedef struct {
+    uint8_t version;
+    bool sound;
+    bool vibro;
+    uint8_t hitstop_frames;
+    uint8_t latency_ms; // display + input latency of this unit, from the calibration screen
+    uint8_t latency_mad_ms;
+    char ai_name[AI_NAME_MAX]; // backend for normal fights, by name since plugin slots can move
+} Settings;
+
+// Tick and ms arithmetic assumes uint16_t/uint8_t promote to a 32-bit int, as on the M4
+_Static_assert(sizeof(int) == 4, "32-bit int expected");
+// settings.bin is the raw struct, its layout must not depend on the target
+_Static_assert(sizeof(Settings) == 22, "settings.bin layout changed");
+
+typedef enum {
+    PowerPhaseMenu = 0,
+    PowerPhaseFight,
+    PowerPhaseCount,
+} PowerPhase;
+
+typedef struct {
+    uint32_t elapsed_ms;
+    uint32_t wakeups;
+    uint32_t updates;
+    uint32_t frames;
+    uint32_t sd_writes;
+    uint32_t vibro_cues;
+} PowerCounters;
+
+typedef enum {
+    CueTelegraph = 0,
+    CueHit,
+    CueOpen,
+    CueKO,
+    CueQuit,
+} CueId;
+
+typedef struct {
+    uint8_t id;
+    uint32_t event_ms;
+    uint32_t expire_ms;
+} Cue;
+
+typedef struct {
+    uint32_t tick;
+    InputKey key;
+    bool press;
+} CmdInject;
+
+// Capture-to-handling delay of short presses, and how often judging at capture time mattered
+typedef struct {
+    uint32_t count;
+    uint32_t queue_ms_sum; // input_cb to the main loop
+    uint32_t queue_ms_max;
+    uint32_t age_ms_sum; // press to handling, on the sim clock
+    uint32_t age_ms_max;
+    uint32_t clamped; // older than INPUT_RETRO_MS, judged at the limit
+    uint32_t saved; // hits and dodges that only counted thanks to the capture time
+} InputLatency;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hitstop_ticks;
+    uint32_t seed;
+    uint32_t clock0;
+    uint32_t ticks; // run length, the time to beat
+    uint32_t count; // inputs that follow, packed tick << 9 | age_ms << 2 | key
+} GhostHeader;
+
+_Static_assert(sizeof(GhostHeader) == 24, "best.ghost header layout changed");
+_Static_assert(INPUT_RETRO_MS + LATENCY_MAX_MS < 128, "input age must fit the 7 bits a ghost record gives it");
+
+typedef struct {
+    GhostHeader hdr;
+    uint32_t in[GHOST_REC_MAX];
+} GhostRecord;
+
+typedef struct Ghost Ghost;
+typedef struct Diff Diff;
+
+// A boss table parsed from bosses.txt; BossDef names point into it
+typedef struct {
+    BossDef def[3];
+    char name[3][BOSS_NAME_MAX];
+} BossTable;
+
+// One boss's record in lifetime.bin. Reaction times (telegraph to dodge press) are a log-bucket
+// sketch: bucket k counts times in [react_edges[k], react_edges[k+1]), so percentiles cost 32 bytes.
+typedef struct {
+    uint32_t fights;
+    uint32_t wins;
+    uint32_t fight_ms;
+    uint32_t damage;
+    uint16_t react[LIFETIME_BUCKETS];
+} LifetimeBoss;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    LifetimeBoss boss[3];
+} LifetimeFile;
+
+_Static_assert(sizeof(LifetimeFile) == 152, "lifetime.bin layout changed");
+
+// The bout in progress, added to its boss's record when it ends
+typedef struct {
+    bool open;
+    bool fought; // got past the walk-in, so leaving now still counts
+    bool armed;
+    bool punched;
+    uint8_t boss;
+    uint32_t start_ms;
+    uint32_t telegraph_ms;
+    uint32_t punch_ms;
+    LifetimeBoss delta;
+} Encounter;
+
 typedef struct {
     Gui* gui;
     ViewPort* view_port;
     FuriMessageQueue* input_queue;
     bool running;
-    Fighter player;
-    Fighter enemy;
-    uint8_t boss_index;
+    FuriMutex* mutex;
+    SceneId scene;
+    void* scene_data;
+    Settings settings;
+    bool settings_dirty;
+    uint8_t start_boss;
+    bool hitstop_shown;
+    // Sim time of each key's last press and the age of the press being handled
+    uint32_t key_press_ms[InputKeyMAX];
+    uint16_t input_age_ms;
+    InputLatency input_lat;
+    SpriteCache sprite_cache[2];
+    uint16_t stat_fights;
+    uint16_t stat_wins;
+    uint16_t stat_losses;
+    Encounter encounter;
+    PowerCounters power[PowerPhaseCount];
+    Sim sim;
     BossDef bosses[3];
-    uint32_t enemy_vulnerable_until_ms;
-    uint32_t enemy_next_action_ms;
-    uint32_t enemy_next_shuffle_ms;
     bool show_msg;
     uint32_t msg_until_ms;
     const char* msg;
+    // Time attack; the ghost is owned by the io worker once handed over for closing
+    FuriThread* io_thread;
+    FuriMessageQueue* io_queue;
+    bool time_attack;
+    bool ta_recording;
+    GhostRecord ta_rec;
+    Ghost* ghost;
+#ifdef BOX_DIFF
+    Diff* diff; // replay being loaded over the command channel
+#endif
+    // Boss AI backends: slot 0 is the built-in one, ai_pick drives normal fights
+    PluginManager* ai_plugins;
+    AiSlot ai_slots[AI_SLOTS_MAX];
+    uint8_t ai_count;
+    uint8_t ai_pick;
+    // Live boss table: the io worker parses bosses.txt into boss_table_next, the game thread flips
+    // it in at a quiet moment. boss_table is NULL until a file has loaded, app->bosses stays built-in.
+    BossTable* boss_table;
+    BossTable* boss_table_next;
+    volatile uint16_t boss_table_err; // line of the last rejected file, 0 when it parsed
+    uint32_t boss_table_mtime; // io worker only
+    uint64_t boss_table_size;
+    // Cue scheduler, runs on its own low priority thread
+    NotificationApp* notif;
+    FuriThread* cue_thread;
+    FuriMessageQueue* cue_queue;
+    uint32_t cue_played;
+    uint32_t cue_stale;
+    uint32_t cue_dropped;
+    uint32_t cue_offset_sum_ms;
+    uint32_t cue_offset_max_ms;
+    // Screen effects, on the sim clock so hit-stop holds them too
+    uint32_t fx_shake_until_ms;
+    uint8_t fx_shake_px;
+    uint32_t fx_flash_until_ms;
+    bool fx_bench;
+    uint32_t fx_frames;
+    uint64_t fx_draw_cyc;
+    uint64_t fx_offset_cyc;
+    uint64_t fx_post_cyc;
+    uint32_t fx_post_max_cyc;
+    // Command channel, only ever set in BOX_CMD_CDC builds
+    bool cmd_driven;
+#ifdef BOX_CMD_CDC
+    FuriStreamBuffer* cmd_rx;
+    FuriSemaphore* cmd_tx_done;
+    const FuriHalUsbInterface* cmd_usb_prev;
+    char cmd_line[CMD_LINE_MAX];
+    uint8_t cmd_len;
+    CmdInject cmd_inject[CMD_INJECT_MAX];
+    uint8_t cmd_inject_count;
+    uint32_t cmd_press_tick[InputKeyMAX];
+    bool cmd_echo;
+    volatile bool cmd_fb_req;
+    volatile bool cmd_fb_ready;
+    uint8_t cmd_fb[FB_SIZE];
+    // ANSI terminal mirror over the command channel
+    bool term_on;
+    uint8_t term_esc;
+    uint8_t term_prev[FB_SIZE];
+    char term_out[TERM_OUT_MAX];
+    uint8_t term_out_len;
+#endif
 } App;
 
 typedef struct {
     InputEvent event;
+    uint32_t tick; // furi tick at capture
+    uint32_t clock_ms; // sim clock at capture
 } InputEventWrap;
 
-static uint32_t now_ms(void) {
-    return furi_get_tick();
+// Sim clock: advances TICK_MS per sim_tick, never reads the RTOS tick directly
+static uint32_t now_ms(const Sim* sim) {
+    return sim->clock_ms;
+}
+
+static void sim_seed(Sim* sim, uint32_t seed) {
+    sim->rng = seed ? seed : 0x9E3779B9;
+}
+
+static uint32_t sim_rand(Sim* sim) {
+    uint32_t x = sim->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->rng = x;
+    return x;
+}
+
+// Wrap-safe deadline test: valid while now and deadline are less than 2^31 ms (~24 days) apart,
+// so it keeps working when the 32-bit clock rolls over after ~49.7 days
+// Unsigned compare: casting a difference >= 2^31 to int32_t is implementation-defined
+static bool time_reached(uint32_t now, uint32_t deadline) {
+    return (uint32_t)(now - deadline) < 0x80000000u;
 }
 
-static int16_t abs16(int16_t v) {
-    return (v < 0) ? -v : v;
+// In 32 bits: an int16 difference can leave int16 (narrowing is implementation-defined) and
+// negating INT16_MIN overflows
+static uint16_t x_distance(int16_t a, int16_t b) {
+    int32_t d = (int32_t)a - b;
+    return (d < 0) ? -d : d;
 }
 
-static void clamp_i16(int16_t* v, int16_t lo, int16_t hi) {
-    if(*v < lo) *v = lo;
-    if(*v > hi) *v = hi;
+// Takes the unclamped value at full width, so nothing is narrowed before it is in range
+static int16_t clamp_i16(int32_t v, int16_t lo, int16_t hi) {
+    return (v < lo) ? lo : (v > hi) ? hi : v;
 }
 
 static void set_msg(App* app, const char* msg, uint32_t duration_ms) {
     app->show_msg = true;
     app->msg = msg;
-    app->msg_until_ms = now_ms() + duration_ms;
+    app->msg_until_ms = now_ms(&app->sim) + duration_ms;
+}
+
+// TWEENS
+// 17-point Q8 curves, linearly interpolated over 16 segments
+static const int16_t curve_lut[CurveCount][17] = {
+    [CurveOut] = {256, 211, 172, 137, 108, 83, 62, 46, 32, 21, 14, 8, 4, 2, 0, 0, 0},
+    [CurveInOut] = {256, 253, 245, 232, 216, 197, 175, 152, 128, 104, 81, 59, 40, 24, 11, 3, 0},
+    [CurvePulse] = {0, 50, 98, 142, 181, 213, 237, 251, 256, 251, 237, 213, 181, 142, 98, 50, 0},
+};
+
+static int16_t tween_value(const Tween* tw) {
+    if(tw->tick >= tw->ticks) return 0;
+    uint16_t phase = (uint32_t)tw->tick * 256 / tw->ticks;
+    const int16_t* lut = curve_lut[tw->curve];
+    int16_t k = lut[phase >> 4] + (((lut[(phase >> 4) + 1] - lut[phase >> 4]) * (phase & 15)) / 16);
+    return ((int32_t)tw->amp * k) / 256;
+}
+
+static int16_t tween_px(const Tween* tw) {
+    return (tween_value(tw) + (tween_value(tw) >= 0 ? 128 : -128)) / 256;
+}
+
+// Start from wherever the tween is now plus delta px, so a kick mid-motion never jumps
+static void tween_kick(Tween* tw, int16_t delta_px, Curve curve, uint32_t duration_ms) {
+    int16_t from = (curve == CurvePulse) ? 0 : tween_value(tw);
+    tw->amp = from + delta_px * 256;
+    tw->curve = curve;
+    tw->tick = 0;
+    tw->ticks = duration_ms / TICK_MS;
+}
+
+static void tween_step(Tween* tw) {
+    if(tw->tick < tw->ticks) tw->tick++;
 }
 
-static void fighter_set_state(Fighter* f, FighterState st, uint32_t duration_ms) {
+static void fighter_tweens_step(Fighter* f) {
+    tween_step(&f->tx);
+    tween_step(&f->ty);
+}
+
+// Gameplay x jumps, the drawn position follows along the curve
+static void fighter_move_x(Fighter* f, int16_t x, Curve curve, uint32_t duration_ms) {
+    tween_kick(&f->tx, f->x - x, curve, duration_ms);
+    f->x = x;
+}
+
+static void fighter_set_state(Fighter* f, FighterState st, uint32_t duration_ms, uint32_t t) {
     f->state = st;
-    f->state_until_ms = now_ms() + duration_ms;
+    f->state_until_ms = t + duration_ms;
 }
 
-static void fighter_update_state(Fighter* f) {
+static void fighter_update_state(Fighter* f, uint32_t t) {
     if(f->state == FighterStateKO) return;
     if(f->state == FighterStateTelegraph) {
-        uint32_t t = now_ms();
-        if(t >= f->flash_next_ms) {
+        if(time_reached(t, f->flash_next_ms)) {
             f->flash = !f->flash;
             f->flash_next_ms = t + 80;
         }
     }
-    if(f->state != FighterStateIdle && now_ms() >= f->state_until_ms) {
-        if(f->state == FighterStateDodging) f->x = f->home_x;
+    if(f->state != FighterStateIdle && time_reached(t, f->state_until_ms)) {
+        if(f->state == FighterStateDodging) fighter_move_x(f, f->home_x, CurveInOut, TWEEN_RETURN_MS);
         f->state = FighterStateIdle;
     }
 }
 
-static bool enemy_is_vulnerable(const App* app) {
-    return now_ms() < app->enemy_vulnerable_until_ms;
+static bool enemy_is_vulnerable(const Sim* sim) {
+    return !time_reached(now_ms(sim), sim->enemy_vulnerable_until_ms);
 }
 
 static void draw_hp_bar(Canvas* canvas, int x, int y, int w, uint8_t hp, uint8_t max_hp) {
@@ -161,67 +765,115 @@ static void draw_ring(Canvas* canvas) {
     canvas_draw_box(canvas, RING_RIGHT - 2, RING_BOTTOM - 6, 2, 6);
 }
 
-// SPRITES PLAYER (Versión A)
-static const uint8_t spr_p_idle1[] = { 0x00,0x00, 0x00,0x00, 0xE0,0x01, 0x10,0x02, 0xB8,0x02, 0x10,0x02, 0xE0,0x01, 0x00,0x00, 0x20,0x04, 0xF0,0x07, 0x20,0x04, 0x20,0x04, 0x70,0x07, 0x20,0x04, 0x0C,0x30, 0x1E,0x78, 0x0C,0x30, 0x20,0x04, 0x20,0x04, 0x60,0x03, 0x60,0x03, 0xE0,0x03, 0xF0,0x07, 0x00,0x00 };
-static const uint8_t spr_p_idle2[] = { 0x00,0x00, 0x00,0x00, 0xE0,0x01, 0x10,0x02, 0xA8,0x02, 0x10,0x02, 0xE0,0x01, 0x00,0x00, 0x20,0x04, 0xF0,0x07, 0x20,0x04, 0x20,0x04, 0x70,0x07, 0x20,0x04, 0x0C,0x30, 0x1E,0x78, 0x0C,0x30, 0x20,0x04, 0x20,0x04, 0x60,0x03, 0x60,0x03, 0xE0,0x03, 0xF0,0x07, 0x00,0x00 };
-static const uint8_t spr_p_punch_up[] = { 0x00,0x00, 0x18,0x00, 0x3C,0x00, 0x18,0x00, 0xE0,0x01, 0x10,0x02, 0xB8,0x02, 0x10,0x02, 0xE0,0x01, 0x00,0x00, 0x20,0x04, 0xF0,0x07, 0x20,0x04, 0x20,0x04, 0x70,0x07, 0x20,0x04, 0x0C,0x30, 0x0C,0x30, 0x0C,0x30, 0x20,0x04, 0x20,0x04, 0x60,0x03, 0x60,0x03, 0xE0,0x03, 0xF0,0x07, 0x00,0x00 };
-static const uint8_t spr_p_dodge[] = { 0x00,0x00, 0xE0,0x01, 0x10,0x02, 0xB8,0x02, 0x10,0x02, 0xE0,0x01, 0x00,0x00, 0x00,0x00, 0x10,0x02, 0xF8,0x07, 0x10,0x02, 0x10,0x02, 0x38,0x03, 0x10,0x02, 0x06,0x18, 0x0F,0x3C, 0x06,0x18, 0x10,0x02, 0x10,0x02, 0x30,0x01, 0x30,0x01, 0x70,0x01, 0xF8,0x03, 0x00,0x00 };
-
-// SPRITES BOSSES (Versión A)
-static const uint8_t b1_idle1[] = { 0x00,0x00, 0x00,0x00, 0xC0,0x01, 0x20,0x02, 0x60,0x02, 0x20,0x02, 0xC0,0x01, 0x00,0x00, 0x20,0x04, 0xE0,0x07, 0x20,0x04, 0x20,0x04, 0xE0,0x07, 0x20,0x04, 0x08,0x10, 0x1C,0x38, 0x08,0x10, 0x20,0x04, 0x20,0x04, 0x40,0x02, 0x40,0x02, 0xC0,0x03, 0xE0,0x07, 0x00,0x00 };
-static const uint8_t b1_idle2[] = { 0x00,0x00, 0x00,0x00, 0xC0,0x01, 0x20,0x02, 0x40,0x02, 0x20,0x02, 0xC0,0x01, 0x00,0x00, 0x20,0x04, 0xE0,0x07, 0x20,0x04, 0x20,0x04, 0xE0,0x07, 0x20,0x04, 0x08,0x10, 0x1C,0x38, 0x08,0x10, 0x20,0x04, 0x20,0x04, 0x40,0x02, 0x40,0x02, 0xC0,0x03, 0xE0,0x07, 0x00,0x00 };
-static const uint8_t b1_punch[] = { 0x00,0x00, 0x00,0x00, 0xC0,0x01, 0x20,0x02, 0x60,0x02, 0x20,0x02, 0xC0,0x01, 0x00,0x00, 0x20,0x04, 0xE0,0x07, 0x20,0x04, 0x20,0x04, 0xE0,0x07, 0x20,0x04, 0x08,0x00, 0x1C,0x00, 0x7F,0x00, 0x20,0x04, 0x20,0x04, 0x40,0x02, 0x40,0x02, 0xC0,0x03, 0xE0,0x07, 0x00,0x00 };
-static const uint8_t b1_hurt[]  = { 0x00,0x00, 0xC0,0x01, 0x20,0x02, 0x60,0x02, 0x20,0x02, 0xC0,0x01, 0x00,0x00, 0x00,0x00, 0x20,0x04, 0xC0,0x03, 0x20,0x04, 0x20,0x04, 0xC0,0x03, 0x20,0x04, 0x18,0x18, 0x00,0x00, 0x18,0x18, 0x20,0x04, 0x20,0x04, 0x40,0x02, 0x40,0x02, 0xC0,0x03, 0xE0,0x07, 0x00,0x00 };
-static const uint8_t b2_idle1[] = { 0x00,0x00, 0x00,0x00, 0xE0,0x01, 0x90,0x02, 0xF8,0x03, 0x90,0x02, 0xE0,0x01, 0x00,0x00, 0x20,0x04, 0xF8,0x0F, 0x20,0x04, 0x20,0x04, 0xF8,0x0F, 0x20,0x04, 0x1C,0x38, 0x3E,0x7C, 0x1C,0x38, 0x20,0x04, 0x20,0x04, 0x60,0x03, 0x60,0x03, 0xF0,0x07, 0xF8,0x0F, 0x00,0x00 };
-static const uint8_t b2_idle2[] = { 0x00,0x00, 0x00,0x00, 0xE0,0x01, 0xD0,0x02, 0xF8,0x03, 0xD0,0x02, 0xE0,0x01, 0x00,0x00, 0x20,0x04, 0xF8,0x0F, 0x20,0x04, 0x20,0x04, 0xF8,0x0F, 0x20,0x04, 0x1C,0x38, 0x3E,0x7C, 0x1C,0x38, 0x20,0x04, 0x20,0x04, 0x60,0x03, 0x60,0x03, 0xF0,0x07, 0xF8,0x0F, 0x00,0x00 };
-static const uint8_t b2_punch[] = { 0x00,0x00, 0x00,0x00, 0xE0,0x01, 0x90,0x02, 0xF8,0x03, 0x90,0x02, 0xE0,0x01, 0x00,0x00, 0x20,0x04, 0xF8,0x0F, 0x20,0x04, 0x20,0x04, 0xF8,0x0F, 0x20,0x04, 0x1C,0x00, 0x3E,0x00, 0xFF,0x03, 0x20,0x04, 0x20,0x04, 0x60,0x03, 0x60,0x03, 0xF0,0x07, 0xF8,0x0F, 0x00,0x00 };
-static const uint8_t b2_hurt[]  = { 0x00,0x00, 0xE0,0x01, 0x90,0x02, 0xF8,0x03, 0x90,0x02, 0xE0,0x01, 0x00,0x00, 0x00,0x00, 0x20,0x04, 0xF0,0x07, 0x20,0x04, 0x20,0x04, 0xF0,0x07, 0x20,0x04, 0x3E,0x3E, 0x00,0x00, 0x3E,0x3E, 0x20,0x04, 0x20,0x04, 0x60,0x03, 0x60,0x03, 0xF0,0x07, 0xF8,0x0F, 0x00,0x00 };
-static const uint8_t b3_idle1[] = { 0x00,0x00, 0x00,0x00, 0xF0,0x0F, 0x10,0x08, 0xF0,0x0F, 0x10,0x08, 0xF0,0x0F, 0x00,0x00, 0x70,0x0E, 0xF8,0x1F, 0x70,0x0E, 0x70,0x0E, 0xF8,0x1F, 0x70,0x0E, 0x38,0x1C, 0x7C,0x3E, 0x38,0x1C, 0x70,0x0E, 0x70,0x0E, 0xE0,0x07, 0xE0,0x07, 0xF8,0x0F, 0xFC,0x1F, 0x00,0x00 };
-static const uint8_t b3_idle2[] = { 0x00,0x00, 0x00,0x00, 0xF0,0x0F, 0x10,0x08, 0xD0,0x0B, 0x10,0x08, 0xF0,0x0F, 0x00,0x00, 0x70,0x0E, 0xF8,0x1F, 0x70,0x0E, 0x70,0x0E, 0xF8,0x1F, 0x70,0x0E, 0x38,0x1C, 0x7C,0x3E, 0x38,0x1C, 0x70,0x0E, 0x70,0x0E, 0xE0,0x07, 0xE0,0x07, 0xF8,0x0F, 0xFC,0x1F, 0x00,0x00 };
-static const uint8_t b3_punch[] = { 0x00,0x00, 0x00,0x00, 0xF0,0x0F, 0x10,0x08, 0xF0,0x0F, 0x10,0x08, 0xF0,0x0F, 0x00,0x00, 0x70,0x0E, 0xF8,0x1F, 0x70,0x0E, 0x70,0x0E, 0xF8,0x1F, 0x70,0x0E, 0x38,0x00, 0x7C,0x00, 0xFF,0x1F, 0x70,0x0E, 0x70,0x0E, 0xE0,0x07, 0xE0,0x07, 0xF8,0x0F, 0xFC,0x1F, 0x00,0x00 };
-static const uint8_t b3_hurt[]  = { 0x00,0x00, 0xE0,0x01, 0x10,0x02, 0xF8,0x03, 0x10,0x02, 0xE0,0x01, 0x00,0x00, 0x00,0x00, 0x70,0x0E, 0xF8,0x0F, 0x70,0x0E, 0x70,0x0E, 0xF8,0x0F, 0x70,0x0E, 0x18,0x18, 0x00,0x00, 0x18,0x18, 0x70,0x0E, 0x70,0x0E, 0xE0,0x07, 0xE0,0x07, 0xF8,0x0F, 0xFC,0x1F, 0x00,0x00 };
-
-static const uint8_t* boss_sprite_idle1(uint8_t bi) { return (bi == 0) ? b1_idle1 : (bi == 1) ? b2_idle1 : b3_idle1; }
-static const uint8_t* boss_sprite_idle2(uint8_t bi) { return (bi == 0) ? b1_idle2 : (bi == 1) ? b2_idle2 : b3_idle2; }
-static const uint8_t* boss_sprite_punch(uint8_t bi) { return (bi == 0) ? b1_punch : (bi == 1) ? b2_punch : b3_punch; }
-static const uint8_t* boss_sprite_hurt(uint8_t bi) { return (bi == 0) ? b1_hurt : (bi == 1) ? b2_hurt : b3_hurt; }
-
-static void draw_fighter(Canvas* canvas, const App* app, const Fighter* f, bool is_player) {
-    bool alt = ((now_ms() / 200) & 1);
+// SPRITES
+// Row-dictionary atlas: each distinct 16 px row is stored once in atlas_rows (LSB = leftmost pixel),
+// a frame is FIGHTER_H indices into it. 486 bytes for the 16 frames that took 768 as plain XBM.
+static const uint16_t atlas_rows[] = {
+    0x0000, 0x01E0, 0x0210, 0x02B8, 0x0420, 0x07F0, 0x0770, 0x300C, 0x781E, 0x0360,
+    0x03E0, 0x02A8, 0x0018, 0x003C, 0x07F8, 0x0338, 0x1806, 0x3C0F, 0x0130, 0x0170,
+    0x03F8, 0x01C0, 0x0220, 0x0260, 0x07E0, 0x1008, 0x381C, 0x0240, 0x03C0, 0x0008,
+    0x001C, 0x007F, 0x1818, 0x0290, 0x0FF8, 0x7C3E, 0x02D0, 0x003E, 0x03FF, 0x3E3E,
+    0x0FF0, 0x0810, 0x0E70, 0x1FF8, 0x1C38, 0x3E7C, 0x1FFC, 0x0BD0, 0x0038, 0x007C,
+    0x1FFF,
+};
+static const uint8_t atlas_frames[SprCount][FIGHTER_H] = {
+    [SprPIdle1] = {0, 0, 1, 2, 3, 2, 1, 0, 4, 5, 4, 4, 6, 4, 7, 8, 7, 4, 4, 9, 9, 10, 5, 0},
+    [SprPIdle2] = {0, 0, 1, 2, 11, 2, 1, 0, 4, 5, 4, 4, 6, 4, 7, 8, 7, 4, 4, 9, 9, 10, 5, 0},
+    [SprPPunch] = {0, 12, 13, 12, 1, 2, 3, 2, 1, 0, 4, 5, 4, 4, 6, 4, 7, 7, 7, 4, 4, 9, 9, 10},
+    [SprPDodge] = {0, 1, 2, 3, 2, 1, 0, 0, 2, 14, 2, 2, 15, 2, 16, 17, 16, 2, 2, 18, 18, 19, 20, 0},
+    [SprB1Idle1] = {0, 0, 21, 22, 23, 22, 21, 0, 4, 24, 4, 4, 24, 4, 25, 26, 25, 4, 4, 27, 27, 28, 24, 0},
+    [SprB1Idle2] = {0, 0, 21, 22, 27, 22, 21, 0, 4, 24, 4, 4, 24, 4, 25, 26, 25, 4, 4, 27, 27, 28, 24, 0},
+    [SprB1Punch] = {0, 0, 21, 22, 23, 22, 21, 0, 4, 24, 4, 4, 24, 4, 29, 30, 31, 4, 4, 27, 27, 28, 24, 0},
+    [SprB1Hurt] = {0, 21, 22, 23, 22, 21, 0, 0, 4, 28, 4, 4, 28, 4, 32, 0, 32, 4, 4, 27, 27, 28, 24, 0},
+    [SprB2Idle1] = {0, 0, 1, 33, 20, 33, 1, 0, 4, 34, 4, 4, 34, 4, 26, 35, 26, 4, 4, 9, 9, 5, 34, 0},
+    [SprB2Idle2] = {0, 0, 1, 36, 20, 36, 1, 0, 4, 34, 4, 4, 34, 4, 26, 35, 26, 4, 4, 9, 9, 5, 34, 0},
+    [SprB2Punch] = {0, 0, 1, 33, 20, 33, 1, 0, 4, 34, 4, 4, 34, 4, 30, 37, 38, 4, 4, 9, 9, 5, 34, 0},
+    [SprB2Hurt] = {0, 1, 33, 20, 33, 1, 0, 0, 4, 5, 4, 4, 5, 4, 39, 0, 39, 4, 4, 9, 9, 5, 34, 0},
+    [SprB3Idle1] = {0, 0, 40, 41, 40, 41, 40, 0, 42, 43, 42, 42, 43, 42, 44, 45, 44, 42, 42, 24, 24, 34, 46, 0},
+    [SprB3Idle2] = {0, 0, 40, 41, 47, 41, 40, 0, 42, 43, 42, 42, 43, 42, 44, 45, 44, 42, 42, 24, 24, 34, 46, 0},
+    [SprB3Punch] = {0, 0, 40, 41, 40, 41, 40, 0, 42, 43, 42, 42, 43, 42, 48, 49, 50, 42, 42, 24, 24, 34, 46, 0},
+    [SprB3Hurt] = {0, 1, 2, 20, 2, 1, 0, 0, 42, 34, 42, 42, 34, 42, 32, 0, 32, 42, 42, 24, 24, 34, 46, 0},
+};
+
+static void sprite_decode(SpriteCache* c, uint8_t id) {
+    if(c->id == id) return;
+    for(uint8_t r = 0; r < FIGHTER_H; r++) {
+        uint16_t row = atlas_rows[atlas_frames[id][r]];
+        c->bits[r * 2] = row & 0xFF;
+        c->bits[r * 2 + 1] = row >> 8;
+    }
+    c->id = id;
+}
+
+// ANIMATION CLIPS
+// Boss clips name a pose, resolved against the current boss's frames when drawn
+static const AnimFrame clip_p_idle[] = {{SprPIdle1, 0, 200, AnimMarkNone}, {SprPIdle2, 0, 200, AnimMarkNone}};
+static const AnimFrame clip_p_punch[] = {
+    {SprPIdle2, 1, 40, AnimMarkNone},
+    {SprPPunch, -2, 120, AnimMarkConnect},
+    {SprPPunch, -1, 0, AnimMarkNone},
+};
+static const AnimFrame clip_p_dodge[] = {{SprPDodge, 0, 0, AnimMarkNone}};
+static const AnimFrame clip_p_hurt[] = {{SprPIdle1, 0, 0, AnimMarkNone}};
+static const AnimFrame clip_b_idle[] = {{BossPoseIdle1, 0, 200, AnimMarkNone}, {BossPoseIdle2, 0, 200, AnimMarkNone}};
+static const AnimFrame clip_b_punch[] = {{BossPosePunch, 0, 0, AnimMarkConnect}};
+static const AnimFrame clip_b_hurt[] = {{BossPoseHurt, 0, 0, AnimMarkNone}};
+
+static const AnimClip anim_clips[ClipCount] = {
+    [ClipPIdle] = {clip_p_idle, COUNT_OF(clip_p_idle), AnimLoop, false},
+    [ClipPPunch] = {clip_p_punch, COUNT_OF(clip_p_punch), AnimOnce, false},
+    [ClipPDodge] = {clip_p_dodge, COUNT_OF(clip_p_dodge), AnimOnce, false},
+    [ClipPHurt] = {clip_p_hurt, COUNT_OF(clip_p_hurt), AnimOnce, false},
+    [ClipBIdle] = {clip_b_idle, COUNT_OF(clip_b_idle), AnimLoop, true},
+    [ClipBPunch] = {clip_b_punch, COUNT_OF(clip_b_punch), AnimOnce, true},
+    [ClipBHurt] = {clip_b_hurt, COUNT_OF(clip_b_hurt), AnimOnce, true},
+};
+
+static const AnimFrame* anim_frame(const Animator* a) {
+    return &anim_clips[a->clip].frames[a->frame];
+}
+
+static uint8_t anim_sprite(const Animator* a, uint8_t boss_index) {
+    const AnimFrame* fr = anim_frame(a);
+    return anim_clips[a->clip].per_boss ? SprB1Idle1 + boss_index * BossPoseCount + fr->sprite : fr->sprite;
+}
+
+// One decode per frame change, one blit per draw, whatever the clip length
+static void draw_fighter(Canvas* canvas, App* app, const Fighter* f, bool is_player) {
+    const Sim* sim = &app->sim;
+    SpriteCache* c = &app->sprite_cache[is_player ? SimFighterPlayer : SimFighterEnemy];
+    int16_t x = f->x + tween_px(&f->tx);
+    int16_t y = f->y + tween_px(&f->ty) + anim_frame(&f->anim)->dy;
+    if(!is_player && f->state == FighterStateTelegraph && f->flash) return;
+    sprite_decode(c, anim_sprite(&f->anim, sim->boss_index));
     if(is_player) {
-        if(f->state == FighterStatePunching) {
-            canvas_draw_xbm(canvas, f->x, f->y - 2, FIGHTER_W, FIGHTER_H, spr_p_punch_up);
-        } else if(f->state == FighterStateDodging) {
-            canvas_draw_xbm(canvas, f->x, f->y, FIGHTER_W, FIGHTER_H, spr_p_dodge);
-        } else if(f->state == FighterStateHitStun) {
-            canvas_draw_xbm(canvas, f->x, f->y, FIGHTER_W, FIGHTER_H, spr_p_idle1);
-        } else {
-            canvas_draw_xbm(canvas, f->x, f->y, FIGHTER_W, FIGHTER_H, alt ? spr_p_idle1 : spr_p_idle2);
-        }
+        canvas_draw_xbm(canvas, x, y, FIGHTER_W, FIGHTER_H, c->bits);
     } else {
-        if(f->state == FighterStateTelegraph && f->flash) return;
-        const uint8_t* s = (f->state == FighterStatePunching) ? boss_sprite_punch(app->boss_index) :
-                           (f->state == FighterStateHitStun) ? boss_sprite_hurt(app->boss_index) :
-                           alt ? boss_sprite_idle1(app->boss_index) : boss_sprite_idle2(app->boss_index);
-        canvas_draw_xbm(canvas, f->x, f->y, FIGHTER_W, FIGHTER_H, s);
+        canvas_draw_xbm(canvas, x + sim->enemy_walk_px, y + sim->enemy_fall_px, FIGHTER_W, FIGHTER_H, c->bits);
         if(f->state == FighterStateHitStun) {
-            canvas_draw_line(canvas, f->x + 6, f->y - 3, f->x + 6, f->y - 5);
-            canvas_draw_line(canvas, f->x + 8, f->y - 3, f->x + 8, f->y - 5);
+            canvas_draw_line(canvas, x + 6, y - 3, x + 6, y - 5);
+            canvas_draw_line(canvas, x + 8, y - 3, x + 8, y - 5);
         }
     }
 }
 
-static void app_draw(Canvas* canvas, void* ctx) {
-    App* app = ctx;
-    canvas_clear(canvas);
+static void ghost_draw(Canvas* canvas, App* app);
+static void ta_draw_hud(Canvas* canvas, App* app);
+
+static void fight_draw(Canvas* canvas, App* app) {
+    const Sim* sim = &app->sim;
     canvas_set_font(canvas, FontSecondary);
     canvas_draw_str(canvas, 2, 7, "ENE");
-    draw_hp_bar(canvas, 24, 2, 38, app->enemy.hp, app->enemy.max_hp);
-    draw_hp_bar(canvas, 70, 2, 38, app->player.hp, app->player.max_hp);
+    draw_hp_bar(canvas, 24, 2, 38, sim->enemy.hp, sim->enemy.max_hp);
+    draw_hp_bar(canvas, 70, 2, 38, sim->player.hp, sim->player.max_hp);
     canvas_draw_str(canvas, 110, 7, "YOU");
     draw_ring(canvas);
-    draw_fighter(canvas, app, &app->enemy, false);
-    draw_fighter(canvas, app, &app->player, true);
+    draw_fighter(canvas, app, &sim->enemy, false);
+    if(app->time_attack) {
+        ghost_draw(canvas, app);
+        ta_draw_hud(canvas, app);
+    }
+    draw_fighter(canvas, app, &sim->player, true);
 
     if(app->show_msg) {
         canvas_set_color(canvas, ColorWhite);
@@ -234,7 +886,8 @@ static void app_draw(Canvas* canvas, void* ctx) {
 
 static void input_cb(InputEvent* input_event, void* ctx) {
     App* app = ctx;
-    InputEventWrap wrap = {.event = *input_event};
+    // Stamped here, not when the loop gets to it; a single aligned word, safe to read off-thread
+    InputEventWrap wrap = {.event = *input_event, .tick = furi_get_tick(), .clock_ms = app->sim.clock_ms};
     furi_message_queue_put(app->input_queue, &wrap, 0);
 }
 
@@ -244,149 +897,3641 @@ static void init_bosses(App* app) {
     app->bosses[2] = (BossDef){"B3 HARD", 10, 260, 220, 520, 550, 500, 78, 22, 1, false};
 }
 
-static void start_boss(App* app, uint8_t idx, bool reset_player_hp) {
-    BossDef* b = &app->bosses[idx];
+static Fighter* sim_fighter(Sim* sim, uint8_t who) {
+    return (who == SimFighterPlayer) ? &sim->player : &sim->enemy;
+}
+
+static void sim_subscribe(Sim* sim, SimEventCallback fn, void* ctx) {
+    furi_check(sim->sub_count < SIM_SUBS_MAX);
+    sim->subs[sim->sub_count++] = (SimSub){fn, ctx};
+}
+
+// BOSS AI
+// Backends only see a BoxAiObs and act through BoxAiOps (box_ai.h). The built-in one is the
+// original enemy_ai_step; its two timers sit first in ai_state, where the state hash expects them.
+typedef struct {
+    uint32_t next_action_ms;
+    uint32_t next_shuffle_ms;
+} AiBuiltinState;
+
+static void ai_builtin_init(void* state, uint32_t now_ms) {
+    AiBuiltinState* s = state;
+    s->next_action_ms = now_ms;
+    s->next_shuffle_ms = now_ms;
+}
+
+static void ai_builtin_hold(void* state, uint32_t until_ms) {
+    ((AiBuiltinState*)state)->next_action_ms = until_ms;
+}
+
+static void ai_builtin_step(void* state, const BoxAiObs* obs, const BoxAiOps* ops, void* ctx) {
+    AiBuiltinState* s = state;
+    uint32_t t = obs->now_ms;
+    if(obs->enemy_state == BoxAiIdle && time_reached(t, s->next_shuffle_ms)) {
+        if((ops->rand(ctx) % 4) == 0) ops->shuffle(ctx, (ops->rand(ctx) & 1) ? +1 : -1);
+        s->next_shuffle_ms = t + 350 + (ops->rand(ctx) % 400);
+    }
+    if(!time_reached(t, s->next_action_ms)) return;
+    if(obs->enemy_state == BoxAiIdle) {
+        int roll = ops->rand(ctx) % 100;
+        if(roll < (obs->dx <= obs->punch_range ? obs->punch_chance_near : obs->punch_chance_far)) {
+            ops->telegraph(ctx);
+        }
+        s->next_action_ms = t + obs->ai_base_delay + (ops->rand(ctx) % obs->ai_rand_delay);
+    }
+}
+
+static const BoxAiBackend ai_builtin = {
+    .name = "BUILT-IN",
+    .budget_cycles = AI_BUILTIN_BUDGET,
+    .state_size = sizeof(AiBuiltinState),
+    .init = ai_builtin_init,
+    .hold = ai_builtin_hold,
+    .step = ai_builtin_step,
+};
+
+_Static_assert(FighterStateKO == (int)BoxAiKO, "BoxAiFighterState must mirror FighterState");
+
+static const BoxAiBackend* sim_ai(const Sim* sim) {
+    return sim->ai ? sim->ai->be : &ai_builtin;
+}
+
+static void start_boss(Sim* sim, uint8_t idx, bool reset_player_hp) {
+    const BossDef* b = &sim->bosses[idx];
+    uint32_t t = now_ms(sim);
     int16_t home = (SCREEN_W / 2) - (FIGHTER_W / 2);
+    sim->boss_index = idx;
     if(reset_player_hp) {
-        app->player.home_x = home; app->player.x = home; app->player.y = PLAYER_Y;
-        app->player.hp = MAX_HP; app->player.max_hp = MAX_HP;
-        fighter_set_state(&app->player, FighterStateIdle, 0);
-    }
-    app->enemy.home_x = home; app->enemy.x = home; app->enemy.y = ENEMY_Y;
-    app->enemy.hp = b->enemy_hp; app->enemy.max_hp = b->enemy_hp;
-    fighter_set_state(&app->enemy, FighterStateIdle, 0);
-    app->enemy_next_action_ms = now_ms() + 700;
-    set_msg(app, b->name, 1000);
-}
-
-static void advance_boss_or_win(App* app) {
-    if(app->boss_index < 2) {
-        app->boss_index++;
-        set_msg(app, "NEXT!", 700);
-        start_boss(app, app->boss_index, true);
+        sim->player.home_x = home; sim->player.x = home; sim->player.y = PLAYER_Y;
+        sim->player.tx = sim->player.ty = (Tween){0};
+        sim->player.hp = MAX_HP; sim->player.max_hp = MAX_HP;
+        fighter_set_state(&sim->player, FighterStateIdle, 0, t);
+    }
+    sim->enemy.home_x = home; sim->enemy.x = home; sim->enemy.y = ENEMY_Y;
+    sim->enemy.tx = sim->enemy.ty = (Tween){0};
+    sim->enemy.hp = b->enemy_hp; sim->enemy.max_hp = b->enemy_hp;
+    fighter_set_state(&sim->enemy, FighterStateIdle, 0, t);
+    sim->enemy.pending_punch = false;
+    // Deadlines are only meaningful near the clock, never leave stale ones behind
+    sim->enemy_vulnerable_until_ms = t;
+    sim_ai(sim)->init(sim->ai_state, t);
+    sim_ai(sim)->hold(sim->ai_state, t + 700);
+}
+
+static bool script_intro(Sim* sim);
+static bool script_knockdown(Sim* sim);
+
+static void script_start(Sim* sim, ScriptFn fn) {
+    sim->script = fn;
+    sim->script_state.line = 0;
+}
+
+// The reducer: the only place combat state changes in response to an event
+static void sim_apply(Sim* sim, const SimEvent* ev) {
+    const BossDef* b = &sim->bosses[sim->boss_index];
+    Fighter* f = sim_fighter(sim, ev->who);
+    uint32_t t = now_ms(sim);
+    switch(ev->type) {
+    case SimEvNewGame:
+        start_boss(sim, ev->arg, true);
+        script_start(sim, script_intro);
+        break;
+    case SimEvTelegraph:
+        fighter_set_state(f, FighterStateTelegraph, ev->arg, t);
+        f->flash = true; f->flash_next_ms = t + 80;
+        f->pending_punch = true;
+        break;
+    case SimEvPunchStarted:
+        fighter_set_state(f, FighterStatePunching, ev->arg, t);
+        break;
+    case SimEvAnimMark:
+        // Lunge toward the other fighter on the connect frame: the player punches up, the enemy down
+        if(ev->arg == AnimMarkConnect) {
+            tween_kick(&f->ty, (ev->who == SimFighterPlayer) ? -TWEEN_LUNGE_PX : TWEEN_LUNGE_PX, CurvePulse, TWEEN_LUNGE_MS);
+        }
+        break;
+    case SimEvDodgeStarted: {
+        f->dodge_dir = ev->arg;
+        int16_t x = clamp_i16(f->home_x + (ev->arg * PLAYER_DODGE_OFFSET), RING_LEFT + 3, RING_RIGHT - 3 - FIGHTER_W);
+        fighter_move_x(f, x, CurveOut, TWEEN_DODGE_MS);
+        fighter_set_state(f, FighterStateDodging, 220, t);
+        break;
+    }
+    case SimEvHitLanded:
+        if(ev->who == SimFighterPlayer) {
+            sim->player_hit_ms = t;
+            sim->player_hit_undo = (f->state == FighterStateIdle && f->hp > ev->arg);
+        }
+        f->hp = (f->hp > ev->arg) ? (f->hp - ev->arg) : 0;
+        fighter_set_state(f, FighterStateHitStun, HIT_STUN_MS, t);
+        tween_kick(&f->ty, (ev->who == SimFighterPlayer) ? TWEEN_KNOCK_PX : -TWEEN_KNOCK_PX, CurveOut, TWEEN_KNOCK_MS);
+        sim->freeze_ticks = sim->hitstop_ticks;
+        break;
+    case SimEvHitUndone:
+        f->hp += ev->arg;
+        f->state = FighterStateIdle;
+        f->ty = (Tween){0};
+        sim->freeze_ticks = 0;
+        sim->player_hit_undo = false;
+        break;
+    case SimEvWindowOpened:
+        sim->enemy_vulnerable_until_ms = t + b->vulnerable_ms;
+        break;
+    case SimEvKO:
+        f->state = FighterStateKO;
+        if(ev->who == SimFighterEnemy) script_start(sim, script_knockdown);
+        break;
+    case SimEvBossAdvanced:
+        start_boss(sim, ev->arg, true);
+        script_start(sim, script_intro);
+        break;
+    case SimEvFightStart:
+        sim_ai(sim)->hold(sim->ai_state, t + 300);
+        break;
+    case SimEvShuffle: {
+        int16_t x = clamp_i16(f->x + ev->arg, RING_LEFT + 3, RING_RIGHT - 3 - FIGHTER_W);
+        fighter_move_x(f, x, CurveInOut, TWEEN_SHUFFLE_MS);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Fixed-size subscriber table, no queueing: an event is applied and delivered in place
+static void sim_emit(Sim* sim, SimEvType type, uint8_t who, int16_t arg) {
+    SimEvent ev = {.type = type, .who = who, .arg = arg};
+    sim_apply(sim, &ev);
+    for(uint8_t i = 0; i < sim->sub_count; i++) sim->subs[i].fn(sim->subs[i].ctx, sim, &ev);
+}
+
+static void advance_boss_or_win(Sim* sim) {
+    if(sim->boss_index < 2) {
+        sim_emit(sim, SimEvBossAdvanced, SimFighterEnemy, sim->boss_index + 1);
     } else {
-        set_msg(app, "YOU WIN!", MSG_MS);
+        sim_emit(sim, SimEvMatchWon, SimFighterPlayer, 0);
     }
 }
 
-static void do_enemy_punch(App* app) {
-    BossDef* b = &app->bosses[app->boss_index];
-    fighter_set_state(&app->enemy, FighterStatePunching, b->punch_ms);
-    int16_t dx = abs16(app->player.x - app->enemy.x);
-    if(app->player.state == FighterStateDodging) {
-        app->enemy_vulnerable_until_ms = now_ms() + b->vulnerable_ms;
-        set_msg(app, "OPEN!", 350);
+static void do_enemy_punch(Sim* sim) {
+    const BossDef* b = &sim->bosses[sim->boss_index];
+    sim_emit(sim, SimEvPunchStarted, SimFighterEnemy, b->punch_ms);
+    uint16_t dx = x_distance(sim->player.x, sim->enemy.x);
+    if(sim->player.state == FighterStateDodging) {
+        sim_emit(sim, SimEvWindowOpened, SimFighterEnemy, b->vulnerable_ms);
         return;
     }
-    if(dx <= PUNCH_RANGE && app->player.state != FighterStateHitStun) {
-        app->player.hp = (app->player.hp > 1) ? (app->player.hp - 1) : 0;
-        fighter_set_state(&app->player, FighterStateHitStun, HIT_STUN_MS);
-        set_msg(app, "HIT!", 350);
-        if(app->player.hp == 0) {
-            app->player.state = FighterStateKO;
-            set_msg(app, "YOU LOSE...", MSG_MS);
-        }
+    if(dx <= PUNCH_RANGE && sim->player.state != FighterStateHitStun) {
+        sim_emit(sim, SimEvHitLanded, SimFighterPlayer, 1);
+        if(sim->player.hp == 0) sim_emit(sim, SimEvKO, SimFighterPlayer, 0);
     }
 }
 
-static void do_player_punch(App* app) {
-    if(app->player.state != FighterStateIdle) return;
-    BossDef* b = &app->bosses[app->boss_index];
-    fighter_set_state(&app->player, FighterStatePunching, b->punch_ms);
-    int16_t dx = abs16(app->player.x - app->enemy.x);
-    if(dx > PUNCH_RANGE) return;
-    bool hittable = enemy_is_vulnerable(app) || (b->telegraph_hittable && app->enemy.state == FighterStateTelegraph);
-    if(!hittable) {
-        set_msg(app, "BLOCK", 240);
+// Was the enemy open, or telegraphing a hittable punch, at sim time c (at most INPUT_RETRO_MS ago)?
+static bool enemy_hittable_at(const Sim* sim, uint32_t c) {
+    const BossDef* b = &sim->bosses[sim->boss_index];
+    uint32_t until = sim->enemy_vulnerable_until_ms;
+    if(!time_reached(c, until) && time_reached(c, until - b->vulnerable_ms)) return true;
+    if(!b->telegraph_hittable || sim->enemy.state != FighterStatePunching) return false;
+    uint32_t start = sim->enemy.state_until_ms - b->punch_ms;
+    return !time_reached(c, start) && time_reached(c, start - b->telegraph_ms);
+}
+
+// c is the sim time the press was captured; true when judging it there rather than now landed the hit
+static bool do_player_punch(Sim* sim, uint32_t c) {
+    if(sim->player.state != FighterStateIdle || sim->script) return false;
+    const BossDef* b = &sim->bosses[sim->boss_index];
+    sim_emit(sim, SimEvPunchStarted, SimFighterPlayer, b->punch_ms);
+    uint16_t dx = x_distance(sim->player.x, sim->enemy.x);
+    if(dx > PUNCH_RANGE) return false;
+    bool hittable = enemy_is_vulnerable(sim) || (b->telegraph_hittable && sim->enemy.state == FighterStateTelegraph);
+    bool late = !hittable && enemy_hittable_at(sim, c);
+    if(!hittable && !late) {
+        sim_emit(sim, SimEvBlocked, SimFighterEnemy, 0);
+        return false;
+    }
+    sim_emit(sim, SimEvHitLanded, SimFighterEnemy, b->player_damage);
+    if(sim->enemy.hp == 0) sim_emit(sim, SimEvKO, SimFighterEnemy, 0);
+    return late;
+}
+
+// A dodge captured before a punch that has since landed takes the hit back and opens the window
+static bool start_player_dodge(Sim* sim, int8_t dir, uint32_t c) {
+    if(sim->script) return false;
+    bool undo = sim->player_hit_undo && sim->player.state == FighterStateHitStun &&
+                !time_reached(c, sim->player_hit_ms);
+    if(!undo && sim->player.state != FighterStateIdle) return false;
+    if(undo) sim_emit(sim, SimEvHitUndone, SimFighterPlayer, 1);
+    sim_emit(sim, SimEvDodgeStarted, SimFighterPlayer, dir);
+    if(undo) sim_emit(sim, SimEvWindowOpened, SimFighterEnemy, sim->bosses[sim->boss_index].vulnerable_ms);
+    return undo;
+}
+
+// Player actions as recorded in replays and ghosts: 0 punch, 1 dodge left, 2 dodge right.
+// age_ms is how long before now the press was captured (plus the unit's calibrated latency);
+// windows are judged at that moment, at most INPUT_RETRO_MS + LATENCY_MAX_MS back.
+// True when that changed the outcome.
+static bool sim_input_at(Sim* sim, uint8_t key, uint16_t age_ms) {
+    if(age_ms > INPUT_RETRO_MS + LATENCY_MAX_MS) age_ms = INPUT_RETRO_MS + LATENCY_MAX_MS;
+    uint32_t c = now_ms(sim) - age_ms;
+    if(key == 0) return do_player_punch(sim, c);
+    return start_player_dodge(sim, key == 1 ? -1 : +1, c);
+}
+
+#ifdef BOX_CMD_CDC
+// Headless tools press on the tick itself
+static void sim_input(Sim* sim, uint8_t key) {
+    sim_input_at(sim, key, 0);
+}
+#endif
+
+typedef struct {
+    Sim* sim;
+    BoxAiObs obs;
+} AiCtx;
+
+static void ai_observe(AiCtx* c) {
+    const Sim* sim = c->sim;
+    const BossDef* b = &sim->bosses[sim->boss_index];
+    c->obs = (BoxAiObs){
+        .now_ms = now_ms(sim),
+        .boss = sim->boss_index,
+        .player_state = sim->player.state,
+        .enemy_state = sim->enemy.state,
+        .player_hp = sim->player.hp,
+        .enemy_hp = sim->enemy.hp,
+        .enemy_open = enemy_is_vulnerable(sim),
+        .player_x = sim->player.x,
+        .enemy_x = sim->enemy.x,
+        .dx = x_distance(sim->player.x, sim->enemy.x),
+        .punch_range = PUNCH_RANGE,
+        .punch_chance_near = b->punch_chance_near,
+        .punch_chance_far = b->punch_chance_far,
+        .ai_base_delay = b->ai_base_delay,
+        .ai_rand_delay = b->ai_rand_delay,
+        .telegraph_ms = b->telegraph_ms,
+    };
+}
+
+static uint32_t ai_op_rand(void* ctx) {
+    return sim_rand(((AiCtx*)ctx)->sim);
+}
+
+static void ai_op_telegraph(void* ctx) {
+    AiCtx* c = ctx;
+    if(c->sim->enemy.state != FighterStateIdle) return;
+    sim_emit(c->sim, SimEvTelegraph, SimFighterEnemy, c->sim->bosses[c->sim->boss_index].telegraph_ms);
+    ai_observe(c);
+}
+
+static void ai_op_shuffle(void* ctx, int8_t dir) {
+    AiCtx* c = ctx;
+    if(c->sim->enemy.state != FighterStateIdle) return;
+    sim_emit(c->sim, SimEvShuffle, SimFighterEnemy, (dir < 0) ? -1 : +1);
+    ai_observe(c);
+}
+
+static const BoxAiOps ai_ops = {ai_op_rand, ai_op_telegraph, ai_op_shuffle};
+
+static void enemy_ai_step(Sim* sim) {
+    if(sim->script) return;
+    if(sim->enemy.state == FighterStateKO || sim->player.state == FighterStateKO) return;
+    AiCtx c = {.sim = sim};
+    ai_observe(&c);
+    AiSlot* slot = sim->ai;
+    if(!slot) {
+        ai_builtin.step(sim->ai_state, &c.obs, &ai_ops, &c);
         return;
     }
-    app->enemy.hp = (app->enemy.hp > b->player_damage) ? (app->enemy.hp - b->player_damage) : 0;
-    fighter_set_state(&app->enemy, FighterStateHitStun, HIT_STUN_MS);
-    set_msg(app, "GOOD!", 300);
-    if(app->enemy.hp == 0) {
-        app->enemy.state = FighterStateKO;
-        set_msg(app, "DOWN!", 800);
-        advance_boss_or_win(app);
+    uint32_t c0 = FX_CYCCNT;
+    slot->be->step(sim->ai_state, &c.obs, &ai_ops, &c);
+    uint32_t cyc = FX_CYCCNT - c0;
+    slot->steps++;
+    slot->cyc_sum += cyc;
+    if(cyc > slot->cyc_max) slot->cyc_max = cyc;
+    if(cyc > slot->be->budget_cycles) slot->over++;
+}
+
+// Back to tick 0 with fresh fighters, the clock starting at clock_ms; bosses and subscribers are kept
+static void sim_reset(Sim* sim, uint32_t clock_ms) {
+    sim->tick = 0;
+    sim->clock_ms = clock_ms;
+    memset(&sim->player, 0, sizeof(Fighter));
+    memset(&sim->enemy, 0, sizeof(Fighter));
+    sim->boss_index = 0;
+    sim->enemy_vulnerable_until_ms = clock_ms;
+    sim_ai(sim)->init(sim->ai_state, clock_ms);
+    sim->script = NULL;
+    sim->enemy_fall_px = 0;
+    sim->enemy_walk_px = 0;
+    sim->freeze_ticks = 0;
+    sim->player_hit_undo = false;
+}
+
+static void reset_game(Sim* sim, uint8_t boss) {
+    sim_emit(sim, SimEvNewGame, SimFighterPlayer, boss);
+}
+
+static void sim_advance_clock(Sim* sim) {
+    sim->tick++;
+    sim->clock_ms += TICK_MS;
+}
+
+// SCRIPTS
+// Walk the new boss in from the right, hold the name banner, then hand over to the AI
+static bool script_intro(Sim* sim) {
+    Script* sc = &sim->script_state;
+    uint32_t t = now_ms(sim);
+    SCRIPT_BEGIN(sc);
+    for(sim->enemy_walk_px = WALK_IN_PX; sim->enemy_walk_px > 0; sim->enemy_walk_px -= 2) {
+        SCRIPT_WAIT_MS(sc, t, WALK_IN_STEP_MS);
+    }
+    SCRIPT_WAIT_MS(sc, t, 400);
+    sim_emit(sim, SimEvFightStart, SimFighterEnemy, 0);
+    SCRIPT_END(sc);
+}
+
+// Boss falls, the referee counts, then the next boss (or the win)
+static bool script_knockdown(Sim* sim) {
+    Script* sc = &sim->script_state;
+    uint32_t t = now_ms(sim);
+    SCRIPT_BEGIN(sc);
+    for(sim->enemy_fall_px = 0; sim->enemy_fall_px < KO_FALL_PX; sim->enemy_fall_px++) {
+        SCRIPT_WAIT_MS(sc, t, KO_FALL_STEP_MS);
+    }
+    SCRIPT_WAIT_MS(sc, t, 300);
+    for(sc->i = 1; sc->i <= KO_COUNT_TO; sc->i++) {
+        sim_emit(sim, SimEvRefCount, SimFighterEnemy, sc->i);
+        SCRIPT_WAIT_MS(sc, t, KO_COUNT_MS);
+    }
+    sim->enemy_fall_px = 0;
+    // Last statement: a boss advance starts the intro script in place of this one
+    advance_boss_or_win(sim);
+    SCRIPT_END(sc);
+}
+
+static ClipId fighter_clip(const Fighter* f, uint8_t who) {
+    bool hurt = (f->state == FighterStateHitStun || f->state == FighterStateKO);
+    if(who == SimFighterPlayer) {
+        return (f->state == FighterStatePunching) ? ClipPPunch :
+               (f->state == FighterStateDodging)  ? ClipPDodge :
+               hurt                               ? ClipPHurt :
+                                                    ClipPIdle;
+    }
+    return (f->state == FighterStatePunching) ? ClipBPunch : hurt ? ClipBHurt : ClipBIdle;
+}
+
+// Clip follows the fighter state; frames advance on sim time, so hit-stop and driven mode hold them
+static void fighter_anim_step(Sim* sim, uint8_t who) {
+    Fighter* f = sim_fighter(sim, who);
+    Animator* a = &f->anim;
+    ClipId want = fighter_clip(f, who);
+    if(a->clip != want) {
+        *a = (Animator){.clip = want};
+    } else {
+        const AnimClip* c = &anim_clips[a->clip];
+        if(a->frame + 1 == c->count && c->mode == AnimOnce) return;
+        a->elapsed_ms += TICK_MS;
+        if(a->elapsed_ms < c->frames[a->frame].ms) return;
+        a->frame = (a->frame + 1 < c->count) ? a->frame + 1 : 0;
+        a->elapsed_ms = 0;
     }
+    if(anim_frame(a)->mark != AnimMarkNone) sim_emit(sim, SimEvAnimMark, who, anim_frame(a)->mark);
 }
 
-static void start_player_dodge(App* app, int8_t dir) {
-    if(app->player.state != FighterStateIdle) return;
-    app->player.dodge_dir = dir;
-    app->player.x = app->player.home_x + (dir * PLAYER_DODGE_OFFSET);
-    clamp_i16(&app->player.x, RING_LEFT + 3, RING_RIGHT - 3 - FIGHTER_W);
-    fighter_set_state(&app->player, FighterStateDodging, 220);
+static void sim_tick(Sim* sim) {
+    if(sim->freeze_ticks > 0) {
+        sim->freeze_ticks--;
+        sim->tick++;
+        return;
+    }
+    sim_advance_clock(sim);
+    uint32_t t = now_ms(sim);
+    if(sim->script) {
+        ScriptFn fn = sim->script;
+        if(fn(sim) && sim->script == fn) sim->script = NULL;
+    }
+    fighter_tweens_step(&sim->player);
+    fighter_tweens_step(&sim->enemy);
+    fighter_update_state(&sim->player, t);
+    fighter_update_state(&sim->enemy, t);
+    if(sim->enemy.pending_punch && sim->enemy.state == FighterStateIdle) {
+        sim->enemy.pending_punch = false;
+        do_enemy_punch(sim);
+    }
+    enemy_ai_step(sim);
+    fighter_anim_step(sim, SimFighterPlayer);
+    fighter_anim_step(sim, SimFighterEnemy);
 }
 
-static void enemy_ai_step(App* app) {
-    uint32_t t = now_ms();
-    if(app->enemy.state == FighterStateKO || app->player.state == FighterStateKO) return;
-    BossDef* b = &app->bosses[app->boss_index];
-    if(app->enemy.state == FighterStateIdle && t >= app->enemy_next_shuffle_ms) {
-        if((rand() % 4) == 0) {
-            app->enemy.x += (rand() & 1) ? +1 : -1;
-            clamp_i16(&app->enemy.x, RING_LEFT + 3, RING_RIGHT - 3 - FIGHTER_W);
+static const char* const count_msgs[] = {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9"};
+
+// Banner messages are just another subscriber of the event stream
+static void app_on_event(void* ctx, const Sim* sim, const SimEvent* ev) {
+    App* app = ctx;
+    switch(ev->type) {
+    case SimEvNewGame:
+        app->fx_shake_until_ms = now_ms(sim);
+        app->fx_flash_until_ms = now_ms(sim);
+        // fallthrough
+    case SimEvBossAdvanced:
+        set_msg(app, sim->bosses[sim->boss_index].name, 1000);
+        break;
+    case SimEvHitLanded:
+        if(ev->who == SimFighterPlayer) {
+            set_msg(app, "HIT!", 350);
+            app->fx_shake_px = FX_SHAKE_PX;
+            app->fx_shake_until_ms = now_ms(sim) + FX_SHAKE_MS;
+        } else {
+            set_msg(app, "GOOD!", 300);
         }
-        app->enemy_next_shuffle_ms = t + 350 + (rand() % 400);
+        break;
+    case SimEvBlocked:
+        set_msg(app, "BLOCK", 240);
+        break;
+    case SimEvWindowOpened:
+        set_msg(app, "OPEN!", 350);
+        break;
+    case SimEvKO:
+        if(ev->who == SimFighterPlayer) set_msg(app, "YOU LOSE...", MSG_MS);
+        else set_msg(app, "DOWN!", 800);
+        app->fx_shake_px = FX_KO_SHAKE_PX;
+        app->fx_shake_until_ms = now_ms(sim) + FX_SHAKE_MS;
+        app->fx_flash_until_ms = now_ms(sim) + FX_FLASH_MS;
+        break;
+    case SimEvMatchWon:
+        set_msg(app, "YOU WIN!", MSG_MS);
+        break;
+    case SimEvRefCount:
+        set_msg(app, count_msgs[ev->arg % COUNT_OF(count_msgs)], KO_COUNT_MS);
+        break;
+    case SimEvFightStart:
+        set_msg(app, "FIGHT!", 500);
+        break;
+    default:
+        break;
     }
-    if(t < app->enemy_next_action_ms) return;
-    if(app->enemy.state == FighterStateIdle) {
-        int16_t dx = abs16(app->player.x - app->enemy.x);
-        int roll = rand() % 100;
-        if(roll < (dx <= PUNCH_RANGE ? b->punch_chance_near : b->punch_chance_far)) {
-            fighter_set_state(&app->enemy, FighterStateTelegraph, b->telegraph_ms);
-            app->enemy.flash = true; app->enemy.flash_next_ms = t + 80;
-            app->enemy.pending_punch = true;
+}
+
+static void stats_on_event(void* ctx, const Sim* sim, const SimEvent* ev) {
+    App* app = ctx;
+    UNUSED(sim);
+    if(ev->type == SimEvNewGame) app->stat_fights++;
+    if(ev->type == SimEvMatchWon) app->stat_wins++;
+    if(ev->type == SimEvKO && ev->who == SimFighterPlayer) app->stat_losses++;
+}
+
+static Ghost* ta_begin(App* app);
+static void ta_post(App* app, Ghost* old);
+static void ta_record(App* app, uint8_t key, uint16_t age_ms);
+static void ta_tick(App* app);
+static void flight_begin(App* app);
+static void flight_input(const Sim* sim, uint8_t key, uint16_t age_ms);
+static void flight_tick(App* app);
+
+static void game_key(App* app, InputKey key) {
+    Sim* sim = &app->sim;
+    // A race is also over once the last boss stays down
+    bool ta_won = app->time_attack && sim->enemy.state == FighterStateKO && !sim->script;
+    if(key == InputKeyOk && (sim->player.state == FighterStateKO || ta_won)) {
+        if(app->time_attack) {
+            // The old ghost leaves the draw under the mutex; io_post can wait, so it posts after
+            furi_mutex_acquire(app->mutex, FuriWaitForever);
+            Ghost* old = ta_begin(app);
+            furi_mutex_release(app->mutex);
+            ta_post(app, old);
+        } else {
+            reset_game(sim, app->start_boss);
         }
-        app->enemy_next_action_ms = t + b->ai_base_delay + (rand() % b->ai_rand_delay);
+        flight_begin(app);
+        return;
     }
+    uint8_t in = (key == InputKeyOk) ? 0 : (key == InputKeyLeft) ? 1 : (key == InputKeyRight) ? 2 : 3;
+    if(in > 2) return;
+    if(app->time_attack) ta_record(app, in, app->input_age_ms);
+    flight_input(sim, in, app->input_age_ms);
+    if(sim_input_at(sim, in, app->input_age_ms)) app->input_lat.saved++;
 }
 
-static void reset_game(App* app) {
-    app->boss_index = 0;
-    start_boss(app, 0, true);
+// Boss names for menus and stats: the loaded table if there is one
+static const BossDef* boss_table_active(const App* app) {
+    return app->boss_table ? app->boss_table->def : app->bosses;
 }
 
-int32_t box_flipper_app(void* p) {
-    UNUSED(p);
-    App* app = malloc(sizeof(App));
-    app->input_queue = furi_message_queue_alloc(8, sizeof(InputEventWrap));
-    init_bosses(app);
-    reset_game(app);
-    app->gui = furi_record_open(RECORD_GUI);
-    app->view_port = view_port_alloc();
-    view_port_draw_callback_set(app->view_port, app_draw, app);
-    view_port_input_callback_set(app->view_port, input_cb, app);
-    gui_add_view_port(app->gui, app->view_port, GuiLayerFullscreen);
+// A new boss table goes in only between exchanges: outside a fight, or with nothing in flight
+// (no intro or knockdown, both fighters idle, no window open), so no punch or window mixes two rows.
+// Time attack keeps the built-in table so ghosts stay valid.
+static void boss_table_swap(App* app) {
+    if(!__atomic_load_n(&app->boss_table_next, __ATOMIC_ACQUIRE)) return;
+    Sim* sim = &app->sim;
+    bool fight = app->scene == SceneFight;
+    if(fight && (sim->script || sim->player.state != FighterStateIdle ||
+                 sim->enemy.state != FighterStateIdle || enemy_is_vulnerable(sim)))
+        return;
+    bool reload = fight && !app->time_attack;
+    // The draw reads names through boss_table and sim->bosses, so both change under its mutex.
+    // Outside a fight sim->bosses may still point into the old table, so it follows too.
+    furi_mutex_acquire(app->mutex, FuriWaitForever);
+    BossTable* old = app->boss_table;
+    app->boss_table = __atomic_exchange_n(&app->boss_table_next, NULL, __ATOMIC_ACQ_REL);
+    if(!fight || reload) sim->bosses = app->boss_table->def;
+    furi_mutex_release(app->mutex);
+    free(old);
+    if(reload) {
+        set_msg(app, "RELOADED", 600);
+        flight_begin(app);
+    }
+}
 
-    app->running = true;
-    uint32_t last_frame = now_ms();
-    while(app->running) {
-        InputEventWrap e;
-        while(furi_message_queue_get(app->input_queue, &e, 0) == FuriStatusOk) {
-            if(e.event.type == InputTypeShort && e.event.key == InputKeyBack) app->running = false;
-            if(e.event.type == InputTypeShort && e.event.key == InputKeyOk) {
-                if(app->player.state == FighterStateKO) reset_game(app);
-                else do_player_punch(app);
-            }
-            if(e.event.type == InputTypeShort && e.event.key == InputKeyLeft) start_player_dodge(app, -1);
-            if(e.event.type == InputTypeShort && e.event.key == InputKeyRight) start_player_dodge(app, +1);
-        }
-        fighter_update_state(&app->player);
-        fighter_update_state(&app->enemy);
-        if(app->enemy.pending_punch && app->enemy.state == FighterStateIdle) {
-            app->enemy.pending_punch = false;
-            do_enemy_punch(app);
-        }
-        if(app->show_msg && now_ms() >= app->msg_until_ms) app->show_msg = false;
-        enemy_ai_step(app);
-        uint32_t t = now_ms();
-        if(t - last_frame >= FRAME_MS) { last_frame = t; view_port_update(app->view_port); }
+// Menus keep the clock (and so command-channel ticks) running, only the fight steps the combat
+static void game_tick(App* app) {
+    boss_table_swap(app);
+    if(app->scene != SceneFight) {
+        sim_advance_clock(&app->sim);
+        return;
+    }
+    sim_tick(&app->sim);
+    flight_tick(app);
+    if(app->time_attack) ta_tick(app);
+    if(app->show_msg && time_reached(now_ms(&app->sim), app->msg_until_ms)) app->show_msg = false;
+}
+
+// POWER
+static PowerCounters* power_now(App* app) {
+    return &app->power[(app->scene == SceneFight) ? PowerPhaseFight : PowerPhaseMenu];
+}
+
+static uint32_t power_estimate_ua(const PowerCounters* c) {
+    if(c->elapsed_ms == 0) return 0;
+    uint64_t nc = (uint64_t)c->wakeups * POWER_WAKEUP_NC + (uint64_t)c->updates * POWER_UPDATE_NC +
+                  (uint64_t)c->frames * POWER_FRAME_NC + (uint64_t)c->sd_writes * POWER_SD_WRITE_NC +
+                  (uint64_t)c->vibro_cues * POWER_VIBRO_NC;
+    return POWER_BASE_UA + (uint32_t)(nc / c->elapsed_ms);
+}
+
+// Every redraw request goes through here so it is counted
+static void app_request_frame(App* app) {
+    power_now(app)->updates++;
+    view_port_update(app->view_port);
+}
+
+static void power_log_session(App* app) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, POWER_LOG_PATH, FSAM_WRITE, FSOM_OPEN_APPEND)) {
+        // Fits the longest phase name and every counter at 10 digits
+        char line[128];
+        for(uint8_t i = 0; i < PowerPhaseCount; i++) {
+            const PowerCounters* c = &app->power[i];
+            int n = snprintf(
+                line,
+                sizeof(line),
+                "%s ms=%lu wake=%lu upd=%lu frm=%lu sd=%lu vib=%lu est_ua=%lu\n",
+                (i == PowerPhaseFight) ? "fight" : "menu",
+                (unsigned long)c->elapsed_ms,
+                (unsigned long)c->wakeups,
+                (unsigned long)c->updates,
+                (unsigned long)c->frames,
+                (unsigned long)c->sd_writes,
+                (unsigned long)c->vibro_cues,
+                (unsigned long)power_estimate_ua(c));
+            storage_file_write(file, line, n);
+        }
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+}
+
+// CUES
+// The game thread only ever does a non-blocking queue put. The worker plays cues in order and
+// drops any that expired while waiting (a telegraph cue after the punch already landed, say).
+#ifndef BOX_CUE_LOG
+static const NotificationSequence seq_cue_telegraph = {
+    &message_note_c5, &message_delay_25, &message_sound_off, NULL,
+};
+static const NotificationSequence seq_cue_hit = {
+    &message_vibro_on, &message_delay_50, &message_vibro_off, NULL,
+};
+static const NotificationSequence seq_cue_open = {
+    &message_note_e6, &message_delay_25, &message_sound_off, NULL,
+};
+static const NotificationSequence seq_cue_ko = {
+    &message_vibro_on, &message_note_c4, &message_delay_250, &message_sound_off, &message_vibro_off, NULL,
+};
+
+static const NotificationSequence* const cue_sequences[] = {
+    [CueTelegraph] = &seq_cue_telegraph,
+    [CueHit] = &seq_cue_hit,
+    [CueOpen] = &seq_cue_open,
+    [CueKO] = &seq_cue_ko,
+};
+#endif
+
+static void cue_play(App* app, const Cue* cue) {
+#ifdef BOX_CUE_LOG
+    UNUSED(app);
+    FURI_LOG_I("BoxCue", "cue %u event %lu", cue->id, (unsigned long)cue->event_ms);
+#else
+    bool vibro = (cue->id == CueHit || cue->id == CueKO);
+    if(vibro ? !app->settings.vibro : !app->settings.sound) return;
+    if(vibro) power_now(app)->vibro_cues++;
+    notification_message(app->notif, cue_sequences[cue->id]);
+#endif
+}
+
+static int32_t cue_worker(void* ctx) {
+    App* app = ctx;
+    Cue cue;
+    while(furi_message_queue_get(app->cue_queue, &cue, FuriWaitForever) == FuriStatusOk) {
+        if(cue.id == CueQuit) break;
+        uint32_t t = furi_get_tick();
+        if(time_reached(t, cue.expire_ms)) {
+            app->cue_stale++;
+            continue;
+        }
+        cue_play(app, &cue);
+        uint32_t offset = furi_get_tick() - cue.event_ms;
+        app->cue_played++;
+        app->cue_offset_sum_ms += offset;
+        if(offset > app->cue_offset_max_ms) app->cue_offset_max_ms = offset;
+    }
+    return 0;
+}
+
+static void cue_post(App* app, CueId id, uint32_t lifetime_ms) {
+    uint32_t t = furi_get_tick();
+    Cue cue = {.id = id, .event_ms = t, .expire_ms = t + lifetime_ms};
+    if(furi_message_queue_put(app->cue_queue, &cue, 0) != FuriStatusOk) app->cue_dropped++;
+}
+
+static void cue_on_event(void* ctx, const Sim* sim, const SimEvent* ev) {
+    App* app = ctx;
+    UNUSED(sim);
+    switch(ev->type) {
+    case SimEvTelegraph:
+        cue_post(app, CueTelegraph, ev->arg);
+        break;
+    case SimEvHitLanded:
+        if(ev->who == SimFighterPlayer) cue_post(app, CueHit, CUE_STALE_MS);
+        break;
+    case SimEvWindowOpened:
+        cue_post(app, CueOpen, CUE_STALE_MS);
+        break;
+    case SimEvKO:
+        cue_post(app, CueKO, CUE_STALE_MS);
+        break;
+    default:
+        break;
+    }
+}
+
+static void cue_start(App* app) {
+    app->notif = furi_record_open(RECORD_NOTIFICATION);
+    app->cue_queue = furi_message_queue_alloc(CUE_QUEUE_LEN, sizeof(Cue));
+    app->cue_thread = furi_thread_alloc_ex("BoxCueWorker", 1024, cue_worker, app);
+    furi_thread_set_priority(app->cue_thread, FuriThreadPriorityLow);
+    furi_thread_start(app->cue_thread);
+}
+
+static void cue_stop(App* app) {
+    Cue quit = {.id = CueQuit};
+    // Quit must get through even if the queue is full of cues
+    while(furi_message_queue_put(app->cue_queue, &quit, 10) != FuriStatusOk) {
+    }
+    furi_thread_join(app->cue_thread);
+    furi_thread_free(app->cue_thread);
+    furi_message_queue_free(app->cue_queue);
+    furi_record_close(RECORD_NOTIFICATION);
+}
+
+// SETTINGS
+static void settings_load(App* app) {
+    app->settings = (Settings){
+        .version = SETTINGS_VERSION,
+        .sound = true,
+        .vibro = true,
+        .hitstop_frames = HITSTOP_FRAMES_DEFAULT,
+        .ai_name = "BUILT-IN",
+    };
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    Settings loaded;
+    if(storage_file_open(file, SETTINGS_PATH, FSAM_READ, FSOM_OPEN_EXISTING) &&
+       storage_file_read(file, &loaded, sizeof(loaded)) == sizeof(loaded) &&
+       loaded.version == SETTINGS_VERSION) {
+        app->settings = loaded;
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+}
+
+static void settings_save(App* app) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, SETTINGS_PATH, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        storage_file_write(file, &app->settings, sizeof(Settings));
+        power_now(app)->sd_writes++;
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+    app->settings_dirty = false;
+}
+
+// AI PLUGINS
+// Backends are .fal plugins, checked against BOX_AI_API_VERSION by the plugin manager. Dropping a
+// new build into AI_PLUGIN_PATH is enough to try it, the game itself is not rebuilt.
+static void ai_load(App* app) {
+    app->ai_slots[0].be = &ai_builtin;
+    app->ai_count = 1;
+    app->ai_plugins = plugin_manager_alloc(BOX_AI_APPID, BOX_AI_API_VERSION, firmware_api_interface);
+    plugin_manager_load_all(app->ai_plugins, APP_ASSETS_PATH("plugins"));
+    plugin_manager_load_all(app->ai_plugins, AI_PLUGIN_PATH);
+    uint32_t n = plugin_manager_get_count(app->ai_plugins);
+    for(uint32_t i = 0; i < n && app->ai_count < AI_SLOTS_MAX; i++) {
+        const BoxAiBackend* be = plugin_manager_get_ep(app->ai_plugins, i);
+        if(!be || !be->init || !be->hold || !be->step || be->state_size > BOX_AI_STATE_MAX) continue;
+        app->ai_slots[app->ai_count++].be = be;
+    }
+    // The saved pick, or the built-in one when its plugin is gone
+    for(uint8_t i = 0; i < app->ai_count; i++) {
+        if(!strncmp(app->ai_slots[i].be->name, app->settings.ai_name, AI_NAME_MAX - 1)) app->ai_pick = i;
+    }
+}
+
+// IO WORKER
+// SD access off the frame path: requests queue up for a low priority thread, which owns the files
+typedef enum {
+    IoGhostOpen,
+    IoGhostFill,
+    IoGhostClose,
+    IoGhostSave,
+    IoLifetimeAdd,
+    IoFlightDump,
+    IoQuit,
+} IoOp;
+
+typedef struct {
+    uint8_t op;
+    uint8_t half;
+    void* data;
+} IoReq;
+
+// LIFETIME STATS
+// Bucket edges at 32 ms * 2^(k/3): 16 buckets span 32 ms to 1.3 s
+static const uint16_t react_edges[LIFETIME_BUCKETS + 1] = {
+    32, 40, 51, 64, 81, 102, 128, 161, 203, 256, 323, 406, 512, 645, 813, 1024, 1290,
+};
+
+static uint8_t react_bucket(uint32_t ms) {
+    uint8_t k = 0;
+    while(k < LIFETIME_BUCKETS - 1 && ms >= react_edges[k + 1]) k++;
+    return k;
+}
+
+// Bucket midpoint at or above fraction q_pct of the samples, 0 with no samples
+static uint16_t react_percentile(const LifetimeBoss* r, uint8_t q_pct) {
+    uint32_t total = 0;
+    for(uint8_t k = 0; k < LIFETIME_BUCKETS; k++) total += r->react[k];
+    if(total == 0) return 0;
+    uint32_t want = (total * q_pct + 99) / 100;
+    uint32_t seen = 0;
+    uint8_t k = 0;
+    for(; k < LIFETIME_BUCKETS - 1; k++) {
+        seen += r->react[k];
+        if(seen >= want) break;
+    }
+    return (react_edges[k] + react_edges[k + 1]) / 2;
+}
+
+static void lifetime_merge(LifetimeBoss* dst, const LifetimeBoss* d) {
+    dst->fights += d->fights;
+    dst->wins += d->wins;
+    dst->fight_ms += d->fight_ms;
+    dst->damage += d->damage;
+    bool full = false;
+    for(uint8_t k = 0; k < LIFETIME_BUCKETS; k++) full |= (dst->react[k] + d->react[k] > UINT16_MAX);
+    // Halving every bucket keeps the shape, so the sketch never saturates
+    for(uint8_t k = 0; k < LIFETIME_BUCKETS; k++) {
+        if(full) dst->react[k] /= 2;
+        uint32_t sum = dst->react[k] + d->react[k];
+        dst->react[k] = (sum > UINT16_MAX) ? UINT16_MAX : sum;
+    }
+}
+
+static bool lifetime_read(File* file, LifetimeFile* life) {
+    return storage_file_read(file, life, sizeof(LifetimeFile)) == sizeof(LifetimeFile) &&
+           life->magic == LIFETIME_MAGIC && life->version == LIFETIME_VERSION;
+}
+
+// io worker: read-modify-write of one 48-byte record, the rest of the file is not touched
+static void lifetime_add(App* app, uint8_t boss, const LifetimeBoss* delta, Storage* storage) {
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, LIFETIME_PATH, FSAM_READ_WRITE, FSOM_OPEN_ALWAYS)) {
+        LifetimeFile life;
+        uint32_t at = offsetof(LifetimeFile, boss) + boss * sizeof(LifetimeBoss);
+        if(!lifetime_read(file, &life)) {
+            // New or foreign file: start it over, zeroed
+            memset(&life, 0, sizeof(life));
+            life.magic = LIFETIME_MAGIC;
+            life.version = LIFETIME_VERSION;
+            lifetime_merge(&life.boss[boss], delta);
+            storage_file_seek(file, 0, true);
+            storage_file_write(file, &life, sizeof(life));
+        } else {
+            lifetime_merge(&life.boss[boss], delta);
+            storage_file_seek(file, at, true);
+            storage_file_write(file, &life.boss[boss], sizeof(LifetimeBoss));
+        }
+        app->power[PowerPhaseFight].sd_writes++;
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+}
+
+static void lifetime_load(LifetimeFile* life) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    if(!storage_file_open(file, LIFETIME_PATH, FSAM_READ, FSOM_OPEN_EXISTING) || !lifetime_read(file, life)) {
+        memset(life, 0, sizeof(LifetimeFile));
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+}
+
+static void io_post(App* app, IoOp op, uint8_t half, void* data);
+
+static void encounter_close(App* app, const Sim* sim, bool won) {
+    Encounter* en = &app->encounter;
+    if(!en->open) return;
+    en->open = false;
+    if(!en->fought) return;
+    en->delta.fights = 1;
+    en->delta.wins = won;
+    en->delta.fight_ms = now_ms(sim) - en->start_ms;
+    LifetimeBoss* delta = malloc(sizeof(LifetimeBoss));
+    memcpy(delta, &en->delta, sizeof(LifetimeBoss));
+    io_post(app, IoLifetimeAdd, en->boss, delta);
+}
+
+// One bout per boss faced: from its walk-in to either KO, or to leaving the fight after FIGHT!
+static void lifetime_on_event(void* ctx, const Sim* sim, const SimEvent* ev) {
+    App* app = ctx;
+    Encounter* en = &app->encounter;
+    uint32_t t = now_ms(sim);
+    switch(ev->type) {
+    case SimEvNewGame:
+    case SimEvBossAdvanced:
+        encounter_close(app, sim, false);
+        memset(en, 0, sizeof(Encounter));
+        en->open = true;
+        en->boss = sim->boss_index;
+        en->start_ms = t;
+        break;
+    case SimEvFightStart:
+        en->fought = true;
+        break;
+    case SimEvTelegraph:
+        en->armed = true;
+        en->punched = false;
+        en->telegraph_ms = t;
+        break;
+    case SimEvPunchStarted:
+        if(ev->who == SimFighterEnemy) {
+            en->punched = true;
+            en->punch_ms = t;
+        }
+        break;
+    case SimEvDodgeStarted: {
+        // Timed from the press, which may predate the punch it took back
+        uint32_t press = t - app->input_age_ms;
+        if(en->armed && (!en->punched || time_reached(en->punch_ms, press))) {
+            uint8_t k = react_bucket(press - en->telegraph_ms);
+            if(en->delta.react[k] < UINT16_MAX) en->delta.react[k]++;
+        }
+        en->armed = false;
+        break;
+    }
+    case SimEvHitLanded:
+        if(ev->who == SimFighterPlayer) en->delta.damage += ev->arg;
+        break;
+    case SimEvHitUndone:
+        en->delta.damage -= ev->arg;
+        break;
+    case SimEvKO:
+        encounter_close(app, sim, ev->who == SimFighterEnemy);
+        break;
+    default:
+        break;
+    }
+}
+
+// BOSS TABLE RELOAD
+// bosses.txt, one boss per line, '#' starts a comment:
+//   name hp telegraph_ms punch_ms vulnerable_ms ai_base_delay ai_rand_delay near% far% damage hittable
+// The whole file must parse, or the table in play is kept.
+static bool boss_parse_line(char* line, BossDef* b, char* name) {
+    char* p = line;
+    while(*p == ' ') p++;
+    size_t n = strcspn(p, " ");
+    if(n == 0 || n >= BOSS_NAME_MAX) return false;
+    memcpy(name, p, n);
+    name[n] = '\0';
+    // Underscores stand in for spaces in names
+    for(char* c = name; *c; c++) if(*c == '_') *c = ' ';
+    p += n;
+    long v[10];
+    for(uint8_t i = 0; i < COUNT_OF(v); i++) {
+        char* end;
+        v[i] = strtol(p, &end, 10);
+        if(end == p) return false;
+        p = end;
+    }
+    if(v[0] < 1 || v[0] > 99 || v[1] < 1 || v[2] < 1 || v[3] < 1 || v[1] > 5000 || v[2] > 5000 || v[3] > 5000) return false;
+    if(v[4] < 1 || v[4] > 10000 || v[5] < 1 || v[5] > 10000 || v[6] > 100 || v[7] > 100 || v[6] < 0 || v[7] < 0) return false;
+    if(v[8] < 1 || v[8] > 99) return false;
+    *b = (BossDef){name, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], v[9] != 0};
+    return true;
+}
+
+static BossTable* boss_table_parse(char* text, uint16_t* err_line) {
+    BossTable* t = malloc(sizeof(BossTable));
+    uint8_t count = 0;
+    uint16_t line_no = 0;
+    for(char* line = text; line && *line;) {
+        char* next = strchr(line, '\n');
+        if(next) *next++ = '\0';
+        line_no++;
+        char* hash = strchr(line, '#');
+        if(hash) *hash = '\0';
+        line[strcspn(line, "\r")] = '\0';
+        if(line[strspn(line, " ")] != '\0') {
+            if(count == 3 || !boss_parse_line(line, &t->def[count], t->name[count])) {
+                *err_line = line_no;
+                free(t);
+                return NULL;
+            }
+            count++;
+        }
+        line = next;
+    }
+    if(count < 3) {
+        *err_line = line_no + 1;
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+// io worker: cheap stat first, the file is only read and parsed when its mtime or size moved
+static void boss_table_poll(App* app, Storage* storage) {
+    FileInfo info;
+    uint32_t mtime = 0;
+    if(storage_common_stat(storage, BOSS_TABLE_PATH, &info) != FSE_OK) return;
+    storage_common_timestamp(storage, BOSS_TABLE_PATH, &mtime);
+    if(mtime == app->boss_table_mtime && info.size == app->boss_table_size) return;
+    app->boss_table_mtime = mtime;
+    app->boss_table_size = info.size;
+    if(info.size > BOSS_TABLE_MAX) {
+        app->boss_table_err = BOSS_TABLE_TOO_LONG;
+        return;
+    }
+    char* text = malloc(BOSS_TABLE_MAX + 1);
+    File* file = storage_file_alloc(storage);
+    size_t got = 0;
+    if(storage_file_open(file, BOSS_TABLE_PATH, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        got = storage_file_read(file, text, BOSS_TABLE_MAX);
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    text[got] = '\0';
+    uint16_t err_line = 0;
+    BossTable* t = boss_table_parse(text, &err_line);
+    free(text);
+    app->boss_table_err = err_line;
+    if(!t) return;
+    // A table the game has not picked up yet is simply superseded
+    free(__atomic_exchange_n(&app->boss_table_next, t, __ATOMIC_ACQ_REL));
+}
+
+// FLIGHT RECORDER
+// Always on during a fight: a keyframe of the Sim (everything before its subscriber table) every
+// FLIGHT_KEY_TICKS, plus one 4-byte entry per input and per change of the fighters' states or hp.
+// Two keyframes are kept so there are always at least FLIGHT_KEY_TICKS of history behind the
+// older one; the ring never holds more than the entries since it. It lives in static RAM, outside
+// the App allocation, and costs a compare per tick between entries. A failed furi_check reboots
+// before the worker could write anything, so only exit and the watchdog dump.
+#define FLIGHT_SIM_BYTES offsetof(Sim, subs)
+
+typedef enum {
+    FlightExit = 0,
+    FlightStuck,
+} FlightReason;
+
+// kind < 3: input key with arg = age ms; kind & 0x80: p.state | e.state << 3, arg = p.hp | e.hp << 4
+typedef struct {
+    uint16_t tick; // low bits of the sim tick
+    uint8_t kind;
+    uint8_t arg;
+} FlightEntry;
+
+typedef struct {
+    uint32_t first; // ring position of its first entry
+    uint32_t tick; // sim tick of the snapshot, which sim[] holds unaligned
+    uint8_t script; // 0 none, 1 intro, 2 knockdown
+    uint8_t ai; // AI slot, 0xFF for the unprofiled built-in one
+    uint8_t table; // 1 when the fight ran on the loaded boss table
+    uint8_t sim[FLIGHT_SIM_BYTES];
+} FlightKey;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sim_bytes; // a dump only converts on the build that wrote it
+    uint8_t reason;
+    uint8_t script;
+    uint8_t ai;
+    uint8_t table;
+    uint16_t entries;
+} FlightHeader;
+
+typedef struct {
+    FlightEntry ring[FLIGHT_ENTRIES];
+    uint32_t written;
+    FlightKey key[2]; // [keys - 1] is the newest
+    uint8_t keys;
+    uint32_t last; // packed fighter states and hp as of the last entry
+    bool tripped; // watchdog fired since the last fresh start
+    bool resync; // history lost to a flood of entries, keyframe again at the end of the tick
+} FlightRec;
+
+static FlightRec flight;
+
+static uint32_t flight_pack(const Sim* sim) {
+    return sim->player.state | sim->enemy.state << 3 | (sim->player.hp > 15 ? 15 : sim->player.hp) << 8 |
+           (sim->enemy.hp > 15 ? 15 : sim->enemy.hp) << 12;
+}
+
+static void flight_keyframe(App* app) {
+    const Sim* sim = &app->sim;
+    if(flight.keys == 2) {
+        flight.key[0] = flight.key[1];
+        flight.keys = 1;
+    }
+    FlightKey* k = &flight.key[flight.keys++];
+    k->first = flight.written;
+    k->tick = sim->tick;
+    k->script = (sim->script == script_intro) ? 1 : (sim->script == script_knockdown) ? 2 : 0;
+    k->ai = sim->ai ? sim->ai - app->ai_slots : 0xFF;
+    k->table = sim->bosses != app->bosses;
+    memcpy(k->sim, sim, FLIGHT_SIM_BYTES);
+}
+
+// A fresh fight, a restart or a new boss table: nothing before it replays into what follows
+static void flight_begin(App* app) {
+    flight.keys = 0;
+    flight.tripped = false;
+    flight.resync = false;
+    flight.last = flight_pack(&app->sim);
+    flight_keyframe(app);
+}
+
+// Never over a keyframe's entries: the older keyframe goes first, and with no keyframe left the
+// entry is dropped until flight_tick takes a new one
+static void flight_put(const Sim* sim, uint8_t kind, uint8_t arg) {
+    while(flight.keys && flight.written - flight.key[0].first >= FLIGHT_ENTRIES) {
+        flight.key[0] = flight.key[1];
+        flight.keys--;
+    }
+    if(!flight.keys) {
+        flight.resync = true;
+        return;
+    }
+    flight.ring[flight.written++ % FLIGHT_ENTRIES] = (FlightEntry){(uint16_t)sim->tick, kind, arg};
+}
+
+static void flight_input(const Sim* sim, uint8_t key, uint16_t age_ms) {
+    if(flight.keys) flight_put(sim, key, (age_ms > 0xFF) ? 0xFF : age_ms);
+}
+
+static bool flight_stuck(const Fighter* f, uint32_t t) {
+    return f->state != FighterStateIdle && f->state != FighterStateKO &&
+           time_reached(t, f->state_until_ms + FLIGHT_STUCK_MS);
+}
+
+static void flight_dump(App* app, FlightReason reason) {
+    if(!flight.keys) return;
+    const FlightKey* k = &flight.key[0];
+    uint16_t n = flight.written - k->first;
+    FlightHeader* h = malloc(sizeof(FlightHeader) + FLIGHT_SIM_BYTES + n * sizeof(FlightEntry));
+    *h = (FlightHeader){FLIGHT_MAGIC, FLIGHT_VERSION, FLIGHT_SIM_BYTES, reason, k->script, k->ai, k->table, n};
+    uint8_t* p = (uint8_t*)(h + 1);
+    memcpy(p, k->sim, FLIGHT_SIM_BYTES);
+    FlightEntry* e = (FlightEntry*)(p + FLIGHT_SIM_BYTES);
+    for(uint16_t i = 0; i < n; i++) e[i] = flight.ring[(k->first + i) % FLIGHT_ENTRIES];
+    io_post(app, IoFlightDump, reason, h);
+}
+
+static void flight_tick(App* app) {
+    const Sim* sim = &app->sim;
+    if(!flight.keys && !flight.resync) return;
+    uint32_t packed = flight_pack(sim);
+    if(packed != flight.last) {
+        flight.last = packed;
+        flight_put(sim, 0x80 | (packed & 0x3F), packed >> 8);
+    }
+    if(flight.resync) {
+        flight.resync = false;
+        flight_keyframe(app);
+    }
+    const FlightKey* k = &flight.key[flight.keys - 1];
+    // A new keyframe before the ring could overrun the older one
+    if(sim->tick - k->tick >= FLIGHT_KEY_TICKS ||
+       flight.written - k->first >= FLIGHT_ENTRIES / 2)
+        flight_keyframe(app);
+    uint32_t t = now_ms(sim);
+    if(!flight.tripped && (flight_stuck(&sim->player, t) || flight_stuck(&sim->enemy, t))) {
+        flight.tripped = true;
+        flight_dump(app, FlightStuck);
+    }
+}
+
+// io worker: an exit dump never replaces a watchdog dump still on the card
+static void flight_write(App* app, FlightHeader* h, Storage* storage) {
+    File* file = storage_file_alloc(storage);
+    FlightHeader old;
+    bool keep = h->reason == FlightExit && storage_file_open(file, FLIGHT_PATH, FSAM_READ, FSOM_OPEN_EXISTING) &&
+                storage_file_read(file, &old, sizeof(old)) == sizeof(old) && old.magic == FLIGHT_MAGIC &&
+                old.reason != FlightExit;
+    storage_file_close(file);
+    if(!keep && storage_file_open(file, FLIGHT_PATH, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        storage_file_write(file, h, sizeof(FlightHeader) + h->sim_bytes + h->entries * sizeof(FlightEntry));
+        app->power[PowerPhaseFight].sd_writes++;
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+}
+
+// TIME ATTACK
+// All three bosses back to back against the clock. The best run is kept on SD as seed + inputs and
+// comes back as a ghost: a second Sim without subscribers, fed from a double buffer the io worker
+// refills chunk by chunk, so the file is never read on the frame path.
+struct Ghost {
+    Sim sim;
+    GhostHeader hdr;
+    uint32_t buf[2][GHOST_CHUNK];
+    // Written by the io worker: a half is only touched by the worker while its ready flag is clear
+    volatile uint8_t len[2];
+    volatile bool ready[2];
+    volatile bool opened;
+    volatile bool missing;
+    File* file; // io worker only
+    bool started;
+    uint8_t front;
+    uint8_t pos;
+    uint32_t consumed;
+    SpriteCache cache;
+    uint8_t bits[FIGHTER_H * 2];
+    uint8_t bits_id;
+    // Cost, for the R command
+    uint32_t steps;
+    uint32_t underruns;
+    uint32_t refills;
+    uint64_t step_cyc;
+    uint32_t step_cyc_max;
+};
+
+static void io_post(App* app, IoOp op, uint8_t half, void* data) {
+    IoReq req = {.op = op, .half = half, .data = data};
+    // Close, save and quit must get through; a refill that cannot queue shows up as an underrun
+    uint32_t wait = (op == IoGhostFill) ? 0 : FuriWaitForever;
+    furi_message_queue_put(app->io_queue, &req, wait);
+}
+
+static void ghost_fill(Ghost* g, uint8_t half) {
+    size_t got = storage_file_read(g->file, g->buf[half], sizeof(g->buf[half]));
+    g->len[half] = got / sizeof(uint32_t);
+    g->ready[half] = true;
+}
+
+static void ghost_open(Ghost* g, Storage* storage) {
+    g->file = storage_file_alloc(storage);
+    if(!storage_file_open(g->file, GHOST_PATH, FSAM_READ, FSOM_OPEN_EXISTING) ||
+       storage_file_read(g->file, &g->hdr, sizeof(GhostHeader)) != sizeof(GhostHeader) ||
+       g->hdr.magic != GHOST_MAGIC || g->hdr.version != GHOST_VERSION || g->hdr.count > GHOST_REC_MAX ||
+       storage_file_size(g->file) != sizeof(GhostHeader) + g->hdr.count * sizeof(uint32_t)) {
+        g->missing = true;
+        return;
+    }
+    ghost_fill(g, 0);
+    ghost_fill(g, 1);
+    g->opened = true;
+}
+
+static void ghost_save(App* app, GhostRecord* rec, Storage* storage) {
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, GHOST_PATH, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        storage_file_write(file, rec, sizeof(GhostHeader) + rec->hdr.count * sizeof(uint32_t));
+        app->power[PowerPhaseFight].sd_writes++;
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+}
+
+static int32_t io_worker(void* ctx) {
+    App* app = ctx;
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    IoReq req;
+    uint32_t polled = furi_get_tick() - BOSS_POLL_MS;
+    while(true) {
+        if(furi_get_tick() - polled >= BOSS_POLL_MS) {
+            polled = furi_get_tick();
+            boss_table_poll(app, storage);
+        }
+        if(furi_message_queue_get(app->io_queue, &req, BOSS_POLL_MS) != FuriStatusOk) continue;
+        if(req.op == IoQuit) break;
+        Ghost* g = req.data;
+        switch(req.op) {
+        case IoGhostOpen:
+            ghost_open(g, storage);
+            break;
+        case IoGhostFill:
+            ghost_fill(g, req.half);
+            break;
+        case IoGhostClose:
+            if(g->file) {
+                storage_file_close(g->file);
+                storage_file_free(g->file);
+            }
+            free(g);
+            break;
+        case IoGhostSave:
+            ghost_save(app, req.data, storage);
+            free(req.data);
+            break;
+        case IoLifetimeAdd:
+            lifetime_add(app, req.half, req.data, storage);
+            free(req.data);
+            break;
+        case IoFlightDump:
+            flight_write(app, req.data, storage);
+            free(req.data);
+            break;
+        default:
+            break;
+        }
+    }
+    furi_record_close(RECORD_STORAGE);
+    return 0;
+}
+
+static void io_start(App* app) {
+    app->io_queue = furi_message_queue_alloc(IO_QUEUE_LEN, sizeof(IoReq));
+    app->io_thread = furi_thread_alloc_ex("BoxIoWorker", 1024, io_worker, app);
+    furi_thread_set_priority(app->io_thread, FuriThreadPriorityLow);
+    furi_thread_start(app->io_thread);
+}
+
+static void io_stop(App* app) {
+    io_post(app, IoQuit, 0, NULL);
+    furi_thread_join(app->io_thread);
+    furi_thread_free(app->io_thread);
+    furi_message_queue_free(app->io_queue);
+}
+
+// Next recorded input, or false while the worker still owes us the next chunk. A file that ends
+// before its count (cut short since it was opened) finishes the ghost.
+static bool ghost_peek(Ghost* g, uint32_t* packed) {
+    if(g->consumed >= g->hdr.count) return false;
+    if(!g->ready[g->front]) return false;
+    if(g->pos >= g->len[g->front]) {
+        g->missing = true;
+        return false;
+    }
+    *packed = g->buf[g->front][g->pos];
+    return true;
+}
+
+static void ghost_pop(App* app, Ghost* g) {
+    g->consumed++;
+    if(++g->pos < g->len[g->front]) return;
+    // Hand the spent half back for the next chunk and carry on with the other one
+    g->ready[g->front] = false;
+    g->pos = 0;
+    if(g->consumed < g->hdr.count) {
+        io_post(app, IoGhostFill, g->front, g);
+        g->refills++;
+    }
+    g->front ^= 1;
+}
+
+// One ghost step: inputs due at this tick, then the tick. False when the stream ran dry.
+static bool ghost_step(App* app, Ghost* g) {
+    uint32_t packed;
+    while(g->consumed < g->hdr.count) {
+        if(!ghost_peek(g, &packed)) return false;
+        if((packed >> 9) != g->sim.tick) break;
+        sim_input_at(&g->sim, packed & 3, (packed >> 2) & 0x7F);
+        ghost_pop(app, g);
+    }
+    uint32_t c0 = FX_CYCCNT;
+    sim_tick(&g->sim);
+    uint32_t cyc = FX_CYCCNT - c0;
+    g->steps++;
+    g->step_cyc += cyc;
+    if(cyc > g->step_cyc_max) g->step_cyc_max = cyc;
+    return true;
+}
+
+// Called with app->mutex held: app->ghost is swapped under the draw. Returns the ghost it replaced,
+// for ta_post.
+static Ghost* ta_begin(App* app) {
+    Sim* sim = &app->sim;
+    sim_reset(sim, now_ms(sim));
+    app->ta_rec.hdr = (GhostHeader){
+        .magic = GHOST_MAGIC,
+        .version = GHOST_VERSION,
+        .hitstop_ticks = sim->hitstop_ticks,
+        .seed = sim->rng,
+        .clock0 = now_ms(sim),
+    };
+    app->ta_recording = true;
+    Ghost* old = app->ghost;
+    Ghost* g = malloc(sizeof(Ghost));
+    memset(g, 0, sizeof(Ghost));
+    g->cache.id = SprCount;
+    g->bits_id = SprCount;
+    app->ghost = g;
+    reset_game(sim, 0);
+    return old;
+}
+
+// The replaced ghost goes to the worker to be freed, the new one to be opened
+static void ta_post(App* app, Ghost* old) {
+    if(old) io_post(app, IoGhostClose, 0, old);
+    io_post(app, IoGhostOpen, 0, app->ghost);
+}
+
+static void ta_end(App* app) {
+    app->ta_recording = false;
+    if(app->ghost) {
+        io_post(app, IoGhostClose, 0, app->ghost);
+        app->ghost = NULL;
+    }
+}
+
+static void ta_record(App* app, uint8_t key, uint16_t age_ms) {
+    GhostHeader* h = &app->ta_rec.hdr;
+    if(!app->ta_recording) return;
+    if(h->count == GHOST_REC_MAX) {
+        // Too long to store, this run cannot become the ghost
+        app->ta_recording = false;
+        return;
+    }
+    app->ta_rec.in[h->count++] = (app->sim.tick << 9) | (age_ms << 2) | key;
+}
+
+// Ghost keeps pace with the live run: one step per live tick, one extra while it is behind
+static void ta_tick(App* app) {
+    Ghost* g = app->ghost;
+    if(!g || g->missing) return;
+    if(!g->started) {
+        if(!g->opened) return;
+        memset(&g->sim, 0, sizeof(Sim));
+        g->sim.bosses = app->sim.bosses;
+        g->sim.hitstop_ticks = g->hdr.hitstop_ticks;
+        sim_seed(&g->sim, g->hdr.seed);
+        sim_reset(&g->sim, g->hdr.clock0);
+        reset_game(&g->sim, 0);
+        g->started = true;
+    }
+    for(uint8_t i = 0; i < 2 && g->sim.tick < app->sim.tick && g->sim.tick < g->hdr.ticks; i++) {
+        if(!ghost_step(app, g)) {
+            g->underruns++;
+            break;
+        }
+    }
+}
+
+static void ta_on_event(void* ctx, const Sim* sim, const SimEvent* ev) {
+    App* app = ctx;
+    if(!app->time_attack || ev->type != SimEvMatchWon || !app->ta_recording) return;
+    app->ta_recording = false;
+    uint32_t ticks = sim->tick;
+    Ghost* g = app->ghost;
+    bool have_best = g && g->opened;
+    if(have_best && ticks >= g->hdr.ticks) return;
+    GhostRecord* rec = malloc(sizeof(GhostHeader) + app->ta_rec.hdr.count * sizeof(uint32_t));
+    app->ta_rec.hdr.ticks = ticks;
+    memcpy(rec, &app->ta_rec, sizeof(GhostHeader) + app->ta_rec.hdr.count * sizeof(uint32_t));
+    io_post(app, IoGhostSave, 0, rec);
+    set_msg(app, "NEW BEST!", MSG_MS);
+}
+
+static void ghost_draw(Canvas* canvas, App* app) {
+    Ghost* g = app->ghost;
+    if(!g || !g->started || g->missing || g->sim.tick >= g->hdr.ticks) return;
+    const Fighter* f = &g->sim.player;
+    uint8_t id = anim_sprite(&f->anim, 0);
+    // Checkerboard-dithered copy of the frame, rebuilt only when the frame changes
+    if(g->bits_id != id) {
+        sprite_decode(&g->cache, id);
+        for(uint8_t i = 0; i < sizeof(g->bits); i++) g->bits[i] = g->cache.bits[i] & (((i >> 1) & 1) ? 0xAA : 0x55);
+        g->bits_id = id;
+    }
+    int16_t x = f->x + tween_px(&f->tx);
+    int16_t y = f->y + tween_px(&f->ty) + anim_frame(&f->anim)->dy;
+    canvas_draw_xbm(canvas, x, y, FIGHTER_W, FIGHTER_H, g->bits);
+}
+
+// Race clock under the ring, and the time to beat once the ghost is loaded
+static void ta_draw_hud(Canvas* canvas, App* app) {
+    char buf[24];
+    uint32_t ms = app->sim.tick * TICK_MS;
+    Ghost* g = app->ghost;
+    if(g && g->opened) {
+        uint32_t best = g->hdr.ticks * TICK_MS;
+        snprintf(buf, sizeof(buf), "%lu.%02lu / %lu.%02lu", (unsigned long)(ms / 1000), (unsigned long)(ms % 1000 / 10),
+            (unsigned long)(best / 1000), (unsigned long)(best % 1000 / 10));
+    } else {
+        snprintf(buf, sizeof(buf), "%lu.%02lu", (unsigned long)(ms / 1000), (unsigned long)(ms % 1000 / 10));
+    }
+    canvas_draw_str_aligned(canvas, SCREEN_W / 2, SCREEN_H, AlignCenter, AlignBottom, buf);
+}
+
+// SCENES
+// Same shape as the SDK SceneManager handlers, but every scene renders into the one ViewPort,
+// so a switch is just exit + enter and the next frame already shows the new scene.
+typedef struct {
+    void (*on_enter)(App* app);
+    void (*on_exit)(App* app);
+    void (*on_key)(App* app, InputKey key);
+    void (*on_draw)(Canvas* canvas, App* app);
+} SceneHandlers;
+
+static const SceneHandlers scene_handlers[SceneCount];
+
+static void scene_switch(App* app, SceneId next) {
+    furi_mutex_acquire(app->mutex, FuriWaitForever);
+    if(scene_handlers[app->scene].on_exit) scene_handlers[app->scene].on_exit(app);
+    free(app->scene_data);
+    app->scene_data = NULL;
+    app->scene = next;
+    if(scene_handlers[next].on_enter) scene_handlers[next].on_enter(app);
+    furi_mutex_release(app->mutex);
+    app_request_frame(app);
+}
+
+static void menu_enter(App* app) {
+    SceneMenu* menu = malloc(sizeof(SceneMenu));
+    menu->cursor = 0;
+    app->scene_data = menu;
+}
+
+static void menu_move(SceneMenu* menu, InputKey key, uint8_t count) {
+    if(key == InputKeyUp) menu->cursor = (menu->cursor + count - 1) % count;
+    if(key == InputKeyDown) menu->cursor = (menu->cursor + 1) % count;
+}
+
+static void menu_draw(Canvas* canvas, const char* title, const char* const* items, uint8_t count, uint8_t cursor) {
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, SCREEN_W / 2, 10, AlignCenter, AlignBottom, title);
+    canvas_set_font(canvas, FontSecondary);
+    // Scrolls once the cursor passes the last visible row
+    uint8_t first = (cursor >= MENU_ROWS) ? cursor - MENU_ROWS + 1 : 0;
+    for(uint8_t i = first; i < count && i < first + MENU_ROWS; i++) {
+        int y = 14 + (i - first) * 12;
+        if(i == cursor) {
+            canvas_draw_box(canvas, 20, y, SCREEN_W - 40, 11);
+            canvas_set_color(canvas, ColorWhite);
+        }
+        canvas_draw_str_aligned(canvas, SCREEN_W / 2, y + 9, AlignCenter, AlignBottom, items[i]);
+        canvas_set_color(canvas, ColorBlack);
+    }
+}
+
+static const char* const title_items[] = {"FIGHT", "TIME ATTACK", "SELECT BOSS", "SETTINGS", "STATS"};
+
+static void title_key(App* app, InputKey key) {
+    SceneMenu* menu = app->scene_data;
+    menu_move(menu, key, COUNT_OF(title_items));
+    if(key == InputKeyBack) app->running = false;
+    if(key != InputKeyOk) return;
+    if(menu->cursor <= 1) {
+        app->start_boss = 0;
+        app->time_attack = (menu->cursor == 1);
+        scene_switch(app, SceneFight);
+    } else {
+        scene_switch(app, SceneBossSelect + menu->cursor - 2);
+    }
+}
+
+static void title_draw(Canvas* canvas, App* app) {
+    SceneMenu* menu = app->scene_data;
+    menu_draw(canvas, "BOX FLIPPER", title_items, COUNT_OF(title_items), menu->cursor);
+}
+
+static void boss_select_key(App* app, InputKey key) {
+    SceneMenu* menu = app->scene_data;
+    menu_move(menu, key, COUNT_OF(app->bosses));
+    if(key == InputKeyBack) scene_switch(app, SceneTitle);
+    if(key == InputKeyOk) {
+        app->start_boss = menu->cursor;
+        app->time_attack = false;
+        scene_switch(app, SceneFight);
+    }
+}
+
+static void boss_select_draw(Canvas* canvas, App* app) {
+    SceneMenu* menu = app->scene_data;
+    const BossDef* bosses = boss_table_active(app);
+    const char* items[COUNT_OF(app->bosses)];
+    for(uint8_t i = 0; i < COUNT_OF(app->bosses); i++) items[i] = bosses[i].name;
+    menu_draw(canvas, "SELECT BOSS", items, COUNT_OF(items), menu->cursor);
+    uint16_t err = app->boss_table_err;
+    if(err) {
+        char line[24];
+        if(err == BOSS_TABLE_TOO_LONG) snprintf(line, sizeof(line), "bosses.txt too long");
+        else snprintf(line, sizeof(line), "bosses.txt line %u", err);
+        canvas_draw_str_aligned(canvas, SCREEN_W / 2, SCREEN_H, AlignCenter, AlignBottom, line);
+    }
+}
+
+static void settings_exit(App* app) {
+    if(app->settings_dirty) settings_save(app);
+}
+
+static void settings_key(App* app, InputKey key) {
+    SceneMenu* menu = app->scene_data;
+    menu_move(menu, key, 5);
+    if(key == InputKeyBack) scene_switch(app, SceneTitle);
+    if(key == InputKeyOk && menu->cursor == 3) {
+        scene_switch(app, SceneCalib);
+    } else if(key == InputKeyOk && menu->cursor == 4) {
+        app->ai_pick = (app->ai_pick + 1) % app->ai_count;
+        snprintf(app->settings.ai_name, sizeof(app->settings.ai_name), "%s", app->ai_slots[app->ai_pick].be->name);
+        app->settings_dirty = true;
+    } else if(key == InputKeyOk) {
+        Settings* st = &app->settings;
+        if(menu->cursor == 0) st->sound = !st->sound;
+        if(menu->cursor == 1) st->vibro = !st->vibro;
+        if(menu->cursor == 2) st->hitstop_frames = (st->hitstop_frames + 1) % (HITSTOP_FRAMES_MAX + 1);
+        app->settings_dirty = true;
+    }
+}
+
+static void settings_draw(Canvas* canvas, App* app) {
+    SceneMenu* menu = app->scene_data;
+    char hitstop[16];
+    char latency[24];
+    char ai[24];
+    snprintf(hitstop, sizeof(hitstop), "HITSTOP: %u", app->settings.hitstop_frames);
+    snprintf(ai, sizeof(ai), "AI: %s", app->ai_slots[app->ai_pick].be->name);
+    snprintf(latency, sizeof(latency), "LATENCY: %u ms", app->settings.latency_ms);
+    const char* items[] = {
+        app->settings.sound ? "SOUND: ON" : "SOUND: OFF",
+        app->settings.vibro ? "VIBRO: ON" : "VIBRO: OFF",
+        hitstop,
+        latency,
+        ai,
+    };
+    menu_draw(canvas, "SETTINGS", items, COUNT_OF(items), menu->cursor);
+}
+
+// Latency calibration: a flash every CALIB_PERIOD_MS, the player taps OK on it. Each tap's
+// offset from its nearest flash (press time, so queueing is already out of it) is one sample.
+typedef struct {
+    uint32_t start_ms;
+    int16_t tap[CALIB_TAPS];
+    uint8_t taps;
+    bool done;
+    uint32_t done_ms;
+    int16_t latency_ms;
+    int16_t mad_ms;
+} CalibData;
+
+static void calib_sort(int16_t* v, uint8_t n) {
+    for(uint8_t i = 1; i < n; i++) {
+        int16_t x = v[i];
+        uint8_t j = i;
+        for(; j > 0 && v[j - 1] > x; j--) v[j] = v[j - 1];
+        v[j] = x;
+    }
+}
+
+static int16_t calib_median(int16_t* v, uint8_t n) {
+    calib_sort(v, n);
+    return (n & 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// Median and MAD, then the median again over the taps within CALIB_MAD_K MADs,
+// so a missed beat or a double tap does not pull the estimate
+static void calib_estimate(CalibData* c) {
+    int16_t v[CALIB_TAPS];
+    int16_t dev[CALIB_TAPS];
+    memcpy(v, c->tap, c->taps * sizeof(int16_t));
+    int16_t med = calib_median(v, c->taps);
+    for(uint8_t i = 0; i < c->taps; i++) dev[i] = abs(c->tap[i] - med);
+    int16_t mad = calib_median(dev, c->taps);
+    int16_t limit = CALIB_MAD_K * (mad > 1 ? mad : 1);
+    uint8_t n = 0;
+    for(uint8_t i = 0; i < c->taps; i++) {
+        if(abs(c->tap[i] - med) <= limit) v[n++] = c->tap[i];
+    }
+    c->latency_ms = calib_median(v, n);
+    c->mad_ms = mad;
+}
+
+static void calib_enter(App* app) {
+    CalibData* c = malloc(sizeof(CalibData));
+    memset(c, 0, sizeof(CalibData));
+    // One silent beat first to pick up the rhythm
+    c->start_ms = now_ms(&app->sim) + CALIB_PERIOD_MS;
+    app->scene_data = c;
+}
+
+static void calib_key(App* app, InputKey key) {
+    CalibData* c = app->scene_data;
+    if(key == InputKeyBack) scene_switch(app, SceneSettings);
+    if(key != InputKeyOk) return;
+    if(c->done) {
+        // Taps still coming in rhythm are not a confirmation
+        if(!time_reached(app->key_press_ms[InputKeyOk], c->done_ms + 2 * CALIB_PERIOD_MS)) return;
+        int16_t lat = c->latency_ms < 0 ? 0 : c->latency_ms > LATENCY_MAX_MS ? LATENCY_MAX_MS : c->latency_ms;
+        app->settings.latency_ms = lat;
+        app->settings.latency_mad_ms = c->mad_ms > 255 ? 255 : c->mad_ms;
+        settings_save(app);
+        scene_switch(app, SceneSettings);
+        return;
+    }
+    int32_t d = (int32_t)(app->key_press_ms[InputKeyOk] - c->start_ms);
+    if(d < -CALIB_PERIOD_MS / 2) return;
+    d %= CALIB_PERIOD_MS;
+    if(d > CALIB_PERIOD_MS / 2) d -= CALIB_PERIOD_MS;
+    c->tap[c->taps++] = d;
+    if(c->taps < CALIB_MIN_TAPS) return;
+    calib_estimate(c);
+    c->done = (c->mad_ms <= CALIB_MAD_OK_MS) || c->taps == CALIB_TAPS;
+    c->done_ms = app->key_press_ms[InputKeyOk];
+}
+
+static void calib_draw(Canvas* canvas, App* app) {
+    CalibData* c = app->scene_data;
+    char line[32];
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, SCREEN_W / 2, 10, AlignCenter, AlignBottom, "CALIBRATE");
+    canvas_set_font(canvas, FontSecondary);
+    if(c->done) {
+        snprintf(line, sizeof(line), "LATENCY %d ms (+-%d)", c->latency_ms, c->mad_ms);
+        canvas_draw_str_aligned(canvas, SCREEN_W / 2, 32, AlignCenter, AlignBottom, line);
+        canvas_draw_str_aligned(canvas, SCREEN_W / 2, 50, AlignCenter, AlignBottom, "OK: SAVE  BACK: CANCEL");
+        return;
+    }
+    uint32_t t = now_ms(&app->sim);
+    if(time_reached(t, c->start_ms) && (t - c->start_ms) % CALIB_PERIOD_MS < CALIB_FLASH_MS) {
+        canvas_draw_box(canvas, SCREEN_W / 2 - 16, 16, 32, 28);
+    } else {
+        canvas_draw_frame(canvas, SCREEN_W / 2 - 16, 16, 32, 28);
+    }
+    snprintf(line, sizeof(line), "TAP OK ON THE FLASH  %u/%u", c->taps, CALIB_TAPS);
+    canvas_draw_str_aligned(canvas, SCREEN_W / 2, 60, AlignCenter, AlignBottom, line);
+}
+
+// Page 0 is this session, pages 1-3 one boss each from lifetime.bin, read once on enter
+typedef struct {
+    uint8_t page;
+    LifetimeFile life;
+} StatsView;
+
+static void stats_enter(App* app) {
+    StatsView* view = malloc(sizeof(StatsView));
+    view->page = 0;
+    lifetime_load(&view->life);
+    app->scene_data = view;
+}
+
+static void stats_key(App* app, InputKey key) {
+    StatsView* view = app->scene_data;
+    if(key == InputKeyLeft) view->page = (view->page + 3) % 4;
+    if(key == InputKeyRight) view->page = (view->page + 1) % 4;
+    if(key == InputKeyBack || key == InputKeyOk) scene_switch(app, SceneTitle);
+}
+
+static void stats_draw_boss(Canvas* canvas, App* app, uint8_t boss, const LifetimeBoss* r) {
+    char line[40];
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, SCREEN_W / 2, 10, AlignCenter, AlignBottom, boss_table_active(app)[boss].name);
+    canvas_set_font(canvas, FontSecondary);
+    uint32_t fights = r->fights ? r->fights : 1;
+    uint32_t avg_ms = r->fight_ms / fights;
+    snprintf(line, sizeof(line), "Fights: %lu  Wins: %lu", (unsigned long)r->fights, (unsigned long)r->wins);
+    canvas_draw_str(canvas, 4, 24, line);
+    snprintf(
+        line,
+        sizeof(line),
+        "Avg %lu.%lus  Dmg %lu.%lu/fight",
+        (unsigned long)(avg_ms / 1000),
+        (unsigned long)(avg_ms % 1000 / 100),
+        (unsigned long)(r->damage / fights),
+        (unsigned long)(r->damage * 10 / fights % 10));
+    canvas_draw_str(canvas, 4, 35, line);
+    snprintf(line, sizeof(line), "Dodge p50 %u p90 %u ms", react_percentile(r, 50), react_percentile(r, 90));
+    canvas_draw_str(canvas, 4, 46, line);
+    canvas_draw_str_aligned(canvas, SCREEN_W / 2, 60, AlignCenter, AlignBottom, "< LIFETIME >");
+}
+
+static void stats_draw(Canvas* canvas, App* app) {
+    StatsView* view = app->scene_data;
+    if(view->page > 0) {
+        stats_draw_boss(canvas, app, view->page - 1, &view->life.boss[view->page - 1]);
+        return;
+    }
+    char line[40];
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str_aligned(canvas, SCREEN_W / 2, 10, AlignCenter, AlignBottom, "STATS  >");
+    canvas_set_font(canvas, FontSecondary);
+    snprintf(line, sizeof(line), "Fights: %u", app->stat_fights);
+    canvas_draw_str(canvas, 4, 24, line);
+    snprintf(line, sizeof(line), "Wins: %u", app->stat_wins);
+    canvas_draw_str(canvas, 4, 35, line);
+    snprintf(line, sizeof(line), "Losses: %u", app->stat_losses);
+    canvas_draw_str(canvas, 4, 46, line);
+    uint32_t menu_ua = power_estimate_ua(&app->power[PowerPhaseMenu]);
+    uint32_t fight_ua = power_estimate_ua(&app->power[PowerPhaseFight]);
+    snprintf(
+        line,
+        sizeof(line),
+        "mA menu %lu.%lu fight %lu.%lu",
+        (unsigned long)(menu_ua / 1000),
+        (unsigned long)(menu_ua % 1000 / 100),
+        (unsigned long)(fight_ua / 1000),
+        (unsigned long)(fight_ua % 1000 / 100));
+    canvas_draw_str(canvas, 4, 57, line);
+}
+
+static void fight_enter(App* app) {
+    if(!app->cmd_driven) sim_seed(&app->sim, furi_hal_random_get());
+    app->sim.hitstop_ticks = app->settings.hitstop_frames * FRAME_MS / TICK_MS;
+    // Ghosts replay against the built-in AI, so time attack always fights it
+    app->sim.ai = &app->ai_slots[app->time_attack ? 0 : app->ai_pick];
+    app->sim.bosses = app->time_attack ? app->bosses : boss_table_active(app);
+    // Scene enter already runs under the mutex
+    if(app->time_attack) ta_post(app, ta_begin(app));
+    else reset_game(&app->sim, app->start_boss);
+    flight_begin(app);
+}
+
+static void fight_exit(App* app) {
+    encounter_close(app, &app->sim, false);
+    ta_end(app);
+}
+
+static void fight_key(App* app, InputKey key) {
+    if(key == InputKeyBack) scene_switch(app, SceneTitle);
+    else game_key(app, key);
+}
+
+// SCREEN EFFECTS
+// Shake and flash run as one pass over the composed page buffer (8 pages x 128 columns,
+// LSB = top pixel) instead of re-issuing every primitive at an offset.
+static const int8_t fx_shake_dx[] = {1, -1, 1, 0, -1, 1, -1, 0};
+static const int8_t fx_shake_dy[] = {0, 1, -1, 1, 0, -1, 1, -1};
+
+static void fx_shift(uint8_t* fb, int8_t dx, int8_t dy) {
+    for(int i = 0; i < SCREEN_W; i++) {
+        // Walk against the shift so each source column is read before it is overwritten
+        int x = (dx > 0) ? (SCREEN_W - 1 - i) : i;
+        int sx = x - dx;
+        uint64_t col = 0;
+        if(sx >= 0 && sx < SCREEN_W) {
+            for(int p = 0; p < SCREEN_H / 8; p++) col |= (uint64_t)fb[p * SCREEN_W + sx] << (p * 8);
+            col = (dy >= 0) ? (col << dy) : (col >> -dy);
+        }
+        for(int p = 0; p < SCREEN_H / 8; p++) fb[p * SCREEN_W + x] = col >> (p * 8);
+    }
+}
+
+static void fx_invert(uint8_t* fb) {
+    for(size_t i = 0; i < FB_SIZE; i++) fb[i] ^= 0xFF;
+}
+
+// Current shake offset, amplitude decaying to zero over FX_SHAKE_MS
+static bool fx_shake_offset(const App* app, int8_t* dx, int8_t* dy) {
+    uint32_t t = now_ms(&app->sim);
+    *dx = 0;
+    *dy = 0;
+    if(time_reached(t, app->fx_shake_until_ms)) return false;
+    uint32_t left = app->fx_shake_until_ms - t;
+    int8_t amp = (app->fx_shake_px * left + FX_SHAKE_MS - 1) / FX_SHAKE_MS;
+    uint8_t k = (t / FRAME_MS) % COUNT_OF(fx_shake_dx);
+    *dx = fx_shake_dx[k] * amp;
+    *dy = fx_shake_dy[k] * amp;
+    return true;
+}
+
+static void fx_draw_fight(Canvas* canvas, App* app) {
+    int8_t dx, dy;
+    bool shake = fx_shake_offset(app, &dx, &dy);
+    bool flash = !time_reached(now_ms(&app->sim), app->fx_flash_until_ms);
+
+    if(app->fx_bench) {
+        // Reference: the same scene re-issued through a canvas offset
+        uint32_t c0 = FX_CYCCNT;
+        canvas_frame_set(canvas, FX_SHAKE_PX, FX_SHAKE_PX, SCREEN_W, SCREEN_H);
+        fight_draw(canvas, app);
+        canvas_frame_set(canvas, 0, 0, SCREEN_W, SCREEN_H);
+        app->fx_offset_cyc += FX_CYCCNT - c0;
+        canvas_clear(canvas);
+    }
+
+    uint32_t c0 = FX_CYCCNT;
+    fight_draw(canvas, app);
+    uint32_t c1 = FX_CYCCNT;
+    // Bench runs the shift every frame, it costs the same with or without an offset
+    if(shake || flash || app->fx_bench) {
+        uint8_t* fb = canvas_get_buffer(canvas);
+        fx_shift(fb, dx, dy);
+        if(flash) fx_invert(fb);
+    }
+    uint32_t c2 = FX_CYCCNT;
+    if(app->fx_bench) {
+        app->fx_frames++;
+        app->fx_draw_cyc += c1 - c0;
+        app->fx_post_cyc += c2 - c1;
+        if(c2 - c1 > app->fx_post_max_cyc) app->fx_post_max_cyc = c2 - c1;
+    }
+}
+
+static const SceneHandlers scene_handlers[SceneCount] = {
+    [SceneTitle] = {menu_enter, NULL, title_key, title_draw},
+    [SceneBossSelect] = {menu_enter, NULL, boss_select_key, boss_select_draw},
+    [SceneSettings] = {menu_enter, settings_exit, settings_key, settings_draw},
+    [SceneStats] = {stats_enter, NULL, stats_key, stats_draw},
+    [SceneFight] = {fight_enter, fight_exit, fight_key, fx_draw_fight},
+    [SceneCalib] = {calib_enter, NULL, calib_key, calib_draw},
+};
+
+static void scene_key(App* app, InputKey key) {
+    scene_handlers[app->scene].on_key(app, key);
+}
+
+// A short press from the input service or the command channel, aged from its press on the sim clock
+static void input_handle(App* app, InputKey key, uint32_t queue_ms) {
+    InputLatency* l = &app->input_lat;
+    uint32_t age = now_ms(&app->sim) - app->key_press_ms[key];
+    l->count++;
+    l->queue_ms_sum += queue_ms;
+    if(queue_ms > l->queue_ms_max) l->queue_ms_max = queue_ms;
+    l->age_ms_sum += age;
+    if(age > l->age_ms_max) l->age_ms_max = age;
+    if(age > INPUT_RETRO_MS) {
+        l->clamped++;
+        age = INPUT_RETRO_MS;
+    }
+    // The player saw the screen latency_ms late, so the press answers what was shown that much earlier
+    app->input_age_ms = age + app->settings.latency_ms;
+    scene_key(app, key);
+    app->input_age_ms = 0;
+}
+
+static void app_draw(Canvas* canvas, void* ctx) {
+    App* app = ctx;
+    furi_mutex_acquire(app->mutex, FuriWaitForever);
+    power_now(app)->frames++;
+    canvas_clear(canvas);
+    scene_handlers[app->scene].on_draw(canvas, app);
+    furi_mutex_release(app->mutex);
+
+#ifdef BOX_CMD_CDC
+    if((app->cmd_fb_req || app->term_on) && !app->cmd_fb_ready) {
+        memcpy(app->cmd_fb, canvas_get_buffer(canvas), FB_SIZE);
+        app->cmd_fb_req = false;
+        app->cmd_fb_ready = true;
+    }
+#endif
+}
+
+// COMMAND CHANNEL
+// Everything from here to cmd_poll is test tooling, compiled only with BOX_CMD_CDC; release builds
+// get the empty stubs below.
+#ifdef BOX_CMD_CDC
+// Line protocol, one command per line, replies are single lines:
+//   N <seed> [clock]       new game at tick 0 with the sim seeded from <seed>, sim clock at [clock] ms, driven mode
+//   K <tick> <key> <p|r>   inject press/release (key: ok left right up down back) at a sim tick
+//   S <n>                  step n ticks                    -> "T <tick>"
+//   Q                      query state                     -> "Q ..."
+//   F                      dump framebuffer, 8 pages       -> "F <page> <hex>" x8
+//   G                      back to real-time play
+//   A                      ANSI terminal mirror: real-time play, raw keys in, diffed frames out
+//   E <0|1>                echo the sim event stream       -> "V <tick> <type> <who> <arg>"
+//   W <seed> <clock> <n> [bot] soak: n ticks of random play (or bot 0-2) on a private sim starting at clock ms
+//                          -> "W <tick> <issue> ..." per issue (first few), then "W done <n> <issues>"
+//   P                      power counters and estimate     -> "P <phase> <ms> <wake> <upd> <frm> <sd> <vib> <uA>" x2
+//   C                      cue stats                       -> "C <played> <stale> <dropped> <avg ms> <max ms>"
+//   H [<seed> <ticks> <hitstop>] replay corpus vs golden hashes -> "H fail ..." per mismatch, "H done <n> <fails>"
+//                          or one run's hash                -> "H <seed> <ticks> <hitstop> <hash>"
+//   R                      time attack ghost cost          -> "R <ghost bytes> <record bytes> <steps> <avg cyc> <max cyc> <underruns> <refills>"
+//   B [<i> [<seed> <fights> [bot]]] boss AI backends: list them   -> "B <i> <name> <budget> <steps> <avg cyc> <max cyc> <over>" x n, "B done <n>"
+//                          pick one for normal fights       -> "OK"
+//                          or run headless fights with it   -> "B bout <fights> <boss wins> <player wins> <draws> <avg ticks>" + its "B <i> ..." line
+//                          with a bot also                  -> "B bot <name> <bot cyc/tick> <sim cyc/tick> <errors>"
+//   J                      flight recorder dump as a replay -> "J <exit|stuck> <tick> <clock> <boss> <entries>",
+//                          "J in <tick> <key> <age>" / "J st <tick> <p.state> <p.hp> <e.state> <e.hp>", "J ok <ticks>" or "J diverge <tick>"
+//   L                      input latency                   -> "L <n> <avg queue ms> <max queue ms> <avg age ms> <max age ms> <clamped> <saved>"
+//   D <seed> <runs> <ticks> differential run vs the reference core (BOX_DIFF builds)
+//                          -> "D ok <runs>", or "D diverge ...", "D min <trials> <ticks run> <ticks skipped>",
+//                             "D repro ..." and "D in <tick> <key>" per input of the minimized stream
+//   D case <seed> <clock> <ticks>, D in <tick> <key> ..., D run  the same for a given replay
+//   X [0|1]                screen effect bench on/off (resets), or read it
+//                          -> "X <frames> <draw cyc> <draw-at-offset cyc> <post-pass cyc> <post max cyc>" (averages)
+static void cmd_write(App* app, const char* s, size_t len) {
+    while(len > 0) {
+        // Short packets only, so the host never waits for a ZLP
+        uint16_t n = (len > CMD_CDC_CHUNK) ? CMD_CDC_CHUNK : len;
+        furi_hal_cdc_send(CMD_CDC_IF, (uint8_t*)s, n);
+        furi_semaphore_acquire(app->cmd_tx_done, 10);
+        s += n;
+        len -= n;
+    }
+}
+
+static void cmd_reply(App* app, const char* s) {
+    cmd_write(app, s, strlen(s));
+}
+
+static void cmd_cdc_rx(void* ctx) {
+    App* app = ctx;
+    uint8_t buf[64];
+    int32_t n = furi_hal_cdc_receive(CMD_CDC_IF, buf, sizeof(buf));
+    if(n > 0) furi_stream_buffer_send(app->cmd_rx, buf, n, 0);
+}
+
+static void cmd_cdc_tx(void* ctx) {
+    App* app = ctx;
+    furi_semaphore_release(app->cmd_tx_done);
+}
+
+static CdcCallbacks cmd_cdc_callbacks = {
+    .tx_ep_callback = cmd_cdc_tx,
+    .rx_ep_callback = cmd_cdc_rx,
+};
+
+static void cmd_open(App* app) {
+    app->cmd_rx = furi_stream_buffer_alloc(CMD_RX_SIZE, 1);
+    app->cmd_tx_done = furi_semaphore_alloc(1, 0);
+    app->cmd_usb_prev = furi_hal_usb_get_config();
+    furi_hal_usb_unlock();
+    furi_check(furi_hal_usb_set_config(&usb_cdc_dual, NULL));
+    furi_hal_cdc_set_callbacks(CMD_CDC_IF, &cmd_cdc_callbacks, app);
+}
+
+static void term_stop(App* app);
+
+static void cmd_close(App* app) {
+    if(app->term_on) term_stop(app);
+    furi_hal_cdc_set_callbacks(CMD_CDC_IF, NULL, NULL);
+    furi_hal_usb_set_config(app->cmd_usb_prev, NULL);
+    furi_semaphore_free(app->cmd_tx_done);
+    furi_stream_buffer_free(app->cmd_rx);
+}
+
+static bool cmd_parse_key(const char* s, InputKey* key) {
+    if(strncmp(s, "ok", 2) == 0) *key = InputKeyOk;
+    else if(strncmp(s, "left", 4) == 0) *key = InputKeyLeft;
+    else if(strncmp(s, "right", 5) == 0) *key = InputKeyRight;
+    else if(strncmp(s, "back", 4) == 0) *key = InputKeyBack;
+    else if(strncmp(s, "up", 2) == 0) *key = InputKeyUp;
+    else if(strncmp(s, "down", 4) == 0) *key = InputKeyDown;
+    else return false;
+    return true;
+}
+
+// Mirrors the input service: a release inside INPUT_LONG_MS of its press is a short press
+static void cmd_apply_inject(App* app, const CmdInject* in) {
+    if(in->press) {
+        app->cmd_press_tick[in->key] = app->sim.tick;
+        app->key_press_ms[in->key] = now_ms(&app->sim);
+    } else if((app->sim.tick - app->cmd_press_tick[in->key]) * TICK_MS < INPUT_LONG_MS) {
+        input_handle(app, in->key, 0);
+    }
+}
+
+static void cmd_step(App* app, uint32_t n) {
+    while(n-- > 0 && app->running) {
+        game_tick(app);
+        for(uint8_t i = 0; i < app->cmd_inject_count;) {
+            if(app->cmd_inject[i].tick <= app->sim.tick) {
+                CmdInject in = app->cmd_inject[i];
+                app->cmd_inject[i] = app->cmd_inject[--app->cmd_inject_count];
+                cmd_apply_inject(app, &in);
+            } else {
+                i++;
+            }
+        }
+    }
+}
+
+static void cmd_query(App* app) {
+    char buf[96];
+    snprintf(
+        buf,
+        sizeof(buf),
+        "Q %lu %u %d %u %d %d %u %d %d %u\n",
+        (unsigned long)app->sim.tick,
+        app->sim.boss_index,
+        app->sim.player.state,
+        app->sim.player.hp,
+        app->sim.player.x,
+        app->sim.enemy.state,
+        app->sim.enemy.hp,
+        app->sim.enemy.x,
+        enemy_is_vulnerable(&app->sim),
+        app->scene);
+    cmd_reply(app, buf);
+}
+
+static void cmd_dump_fb(App* app) {
+    static const char hex[] = "0123456789abcdef";
+    char buf[8 + SCREEN_W * 2];
+    for(uint8_t page = 0; page < SCREEN_H / 8; page++) {
+        int n = snprintf(buf, sizeof(buf), "F %u ", page);
+        const uint8_t* row = &app->cmd_fb[page * SCREEN_W];
+        for(uint8_t x = 0; x < SCREEN_W; x++) {
+            buf[n++] = hex[row[x] >> 4];
+            buf[n++] = hex[row[x] & 0xF];
+        }
+        buf[n++] = '\n';
+        cmd_write(app, buf, n);
+    }
+}
+
+// TERMINAL MIRROR
+// Each character cell is one column and two rows of pixels drawn as a Unicode half block,
+// so the whole screen is 128x32 cells. Only cells that changed since the last frame are sent.
+static const char* const term_glyph[4] = {" ", "\xE2\x96\x80", "\xE2\x96\x84", "\xE2\x96\x88"};
+
+static void term_flush(App* app) {
+    cmd_write(app, app->term_out, app->term_out_len);
+    app->term_out_len = 0;
+}
+
+static void term_put(App* app, const char* s) {
+    size_t len = strlen(s);
+    if(app->term_out_len + len > TERM_OUT_MAX) term_flush(app);
+    memcpy(&app->term_out[app->term_out_len], s, len);
+    app->term_out_len += len;
+}
+
+static uint8_t term_cell(const uint8_t* fb, uint8_t cx, uint8_t cy) {
+    uint8_t bits = fb[(cy >> 2) * SCREEN_W + cx] >> ((cy & 3) * 2);
+    return bits & 3;
+}
+
+static void term_redraw(App* app) {
+    char pos[16];
+    for(uint8_t cy = 0; cy < SCREEN_H / 2; cy++) {
+        bool in_run = false;
+        for(uint8_t cx = 0; cx < SCREEN_W; cx++) {
+            uint8_t cell = term_cell(app->cmd_fb, cx, cy);
+            if(cell == term_cell(app->term_prev, cx, cy)) {
+                in_run = false;
+                continue;
+            }
+            if(!in_run) {
+                snprintf(pos, sizeof(pos), "\x1b[%u;%uH", cy + 1, cx + 1);
+                term_put(app, pos);
+                in_run = true;
+            }
+            term_put(app, term_glyph[cell]);
+        }
+    }
+    term_flush(app);
+    memcpy(app->term_prev, app->cmd_fb, FB_SIZE);
+}
+
+static void term_start(App* app) {
+    app->term_on = true;
+    app->term_esc = 0;
+    app->cmd_driven = false;
+    memset(app->term_prev, 0, FB_SIZE);
+    cmd_reply(app, "\x1b[2J\x1b[?25l");
+}
+
+static void term_stop(App* app) {
+    app->term_on = false;
+    snprintf(app->term_out, TERM_OUT_MAX, "\x1b[%u;1H\x1b[?25h\r\n", SCREEN_H / 2 + 1);
+    cmd_reply(app, app->term_out);
+}
+
+// A keystroke is a short press made now, so it is judged and counted like a device key
+static void term_press(App* app, InputKey key) {
+    app->key_press_ms[key] = now_ms(&app->sim);
+    input_handle(app, key, 0);
+}
+
+// Raw keystrokes: arrows or w/a/s/d move, space/enter is OK, q or backspace is Back, Ctrl-C leaves the mirror
+static void term_key(App* app, char c) {
+    if(app->term_esc == 1) {
+        app->term_esc = (c == '[') ? 2 : 0;
+        return;
+    }
+    if(app->term_esc == 2) {
+        app->term_esc = 0;
+        if(c == 'D') term_press(app, InputKeyLeft);
+        if(c == 'C') term_press(app, InputKeyRight);
+        if(c == 'A') term_press(app, InputKeyUp);
+        if(c == 'B') term_press(app, InputKeyDown);
+        return;
+    }
+    switch(c) {
+    case 0x1b:
+        app->term_esc = 1;
+        break;
+    case 0x03:
+        term_stop(app);
+        break;
+    case ' ':
+    case '\r':
+        term_press(app, InputKeyOk);
+        break;
+    case 'w':
+        term_press(app, InputKeyUp);
+        break;
+    case 's':
+        term_press(app, InputKeyDown);
+        break;
+    case 'a':
+        term_press(app, InputKeyLeft);
+        break;
+    case 'd':
+        term_press(app, InputKeyRight);
+        break;
+    case 'q':
+    case 0x7f:
+        term_press(app, InputKeyBack);
+        break;
+    default:
+        break;
+    }
+}
+
+// BOT PLAYERS
+// Parameterized stand-ins for a human, for the headless tools. A bot sees the same BoxAiObs a
+// boss backend does and presses through sim_input_at with an age, like the input service.
+// Reaction times are log-normal around a median. Like a player watching the screen, a bot looks
+// once per frame, so each press is judged at the ms the bot meant it. Everything random comes
+// from the bot's own seeded stream: a bot never shifts the fight's rolls, and a (profile, seed)
+// pair always plays the same game.
+typedef struct {
+    const char* name;
+    uint16_t react_median_ms; // flash (or window) to press
+    uint8_t react_sigma_q8; // spread of ln(reaction), 256 = 1.0
+    uint8_t error_pct; // reactions to a flash that press OK instead of dodging
+    uint8_t dodge_left_pct;
+    uint8_t aggression_pct; // chance to keep punching at each chance inside the window
+    uint16_t punch_gap_ms; // between punches in one window
+} BotProfile;
+
+static const BotProfile bot_profiles[] = {
+    {"NOVICE", 340, 90, 12, 70, 45, 260},
+    {"CLUB", 260, 64, 5, 55, 70, 200},
+    {"PRO", 200, 38, 2, 50, 90, 160},
+};
+
+typedef struct {
+    const BotProfile* p;
+    uint32_t rng;
+    uint8_t seen_enemy; // enemy state on the previous step, to catch the flash as it starts
+    bool seen_open;
+    bool dodge_due;
+    bool punch_due;
+    uint32_t dodge_ms;
+    uint32_t punch_ms;
+    uint8_t look_in; // ticks to the next look
+    uint32_t errors;
+} Bot;
+
+static uint32_t bot_rand(Bot* bot) {
+    uint32_t x = bot->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return bot->rng = x;
+}
+
+static void bot_init(Bot* bot, uint8_t profile, uint32_t seed) {
+    *bot = (Bot){.p = &bot_profiles[profile], .rng = seed ? seed : 1};
+}
+
+// median * e^(sigma * z), z ~ N(0,1) from four uniform bytes (Irwin-Hall), e^x as 2^(x log2 e)
+// with a quadratic for the fraction. Integer only, so host tools and the device agree.
+static uint32_t bot_reaction_ms(Bot* bot) {
+    uint32_t r = bot_rand(bot);
+    int32_t sum = (int32_t)(r & 0xFF) + ((r >> 8) & 0xFF) + ((r >> 16) & 0xFF) + (r >> 24);
+    int32_t z_q8 = (sum - 510) * 443 / 256; // sqrt(3) * 256, unit variance
+    int32_t y_q8 = z_q8 * bot->p->react_sigma_q8 / 256 * 369 / 256; // log2(e) * 256
+    // |y| stays under 8.0 for sigma <= 1, offset it so the shift below never sees a negative
+    uint32_t y = (uint32_t)(y_q8 + 8 * 256);
+    uint32_t f = y & 0xFF;
+    uint32_t m = 256 + ((f * (168 + ((88 * f) >> 8))) >> 8);
+    uint32_t v = bot->p->react_median_ms * m;
+    uint32_t k = y >> 8;
+    return (k >= 8) ? (v << (k - 8)) >> 8 : (v >> (8 - k)) >> 8;
+}
+
+// Aged press, as the input service would deliver it: a late one is judged at the INPUT_RETRO_MS limit
+static void bot_press(Sim* sim, uint8_t key, uint32_t due_ms, uint32_t now) {
+    sim_input_at(sim, key, (now - due_ms < INPUT_RETRO_MS) ? now - due_ms : INPUT_RETRO_MS);
+}
+
+// Every tick, but it only looks at the fight once per frame; at most one press per look
+static void bot_step(Bot* bot, Sim* sim) {
+    if(bot->look_in) {
+        bot->look_in--;
+        return;
+    }
+    bot->look_in = FRAME_MS / TICK_MS - 1;
+    if(sim->script) return;
+    AiCtx c = {.sim = sim};
+    ai_observe(&c);
+    const BoxAiObs* o = &c.obs;
+    // Dodge on the learned beat of the punch, never before the flash has been seen. One draw
+    // sets both, so a slow reaction is also a late dodge.
+    if(o->enemy_state == BoxAiTelegraph && bot->seen_enemy != BoxAiTelegraph) {
+        int32_t r = bot_reaction_ms(bot);
+        int32_t aim = (int32_t)o->telegraph_ms - BOT_DODGE_AIM_MS + (r - bot->p->react_median_ms) / 2;
+        bot->dodge_due = true;
+        bot->dodge_ms = o->now_ms + ((r > aim) ? r : aim);
+    }
+    if(o->enemy_open && !bot->seen_open) {
+        bot->punch_due = true;
+        bot->punch_ms = o->now_ms + bot_reaction_ms(bot);
+    }
+    bot->seen_enemy = o->enemy_state;
+    bot->seen_open = o->enemy_open;
+    if(o->player_state != BoxAiIdle) return;
+    if(bot->dodge_due && time_reached(o->now_ms, bot->dodge_ms)) {
+        bot->dodge_due = false;
+        if(bot_rand(bot) % 100 < bot->p->error_pct) {
+            bot->errors++;
+            bot_press(sim, 0, bot->dodge_ms, o->now_ms);
+        } else {
+            bot_press(sim, (bot_rand(bot) % 100 < bot->p->dodge_left_pct) ? 1 : 2, bot->dodge_ms, o->now_ms);
+        }
+        return;
+    }
+    if(!o->enemy_open) bot->punch_due = false;
+    if(bot->punch_due && time_reached(o->now_ms, bot->punch_ms)) {
+        bot_press(sim, 0, bot->punch_ms, o->now_ms);
+        // Each further punch is a fresh decision, a cautious bot backs off early
+        bot->punch_due = bot_rand(bot) % 100 < bot->p->aggression_pct;
+        bot->punch_ms = o->now_ms + bot->p->punch_gap_ms;
+    }
+}
+
+static uint8_t bot_parse(const char* p) {
+    char* end;
+    unsigned long i = strtoul(p, &end, 10);
+    return (end == p || i >= COUNT_OF(bot_profiles)) ? BOT_NONE : i;
+}
+
+// SOAK
+// Random play on a throw-away Sim, checking that every state and window ends exactly when its
+// deadline says so. Started just before 0xFFFFFFFF it covers the tick wraparound.
+#define SOAK_REPORT_MAX 8
+
+typedef struct {
+    App* app;
+    bool restart;
+    bool window_open;
+    uint32_t window_until_ms;
+    bool boss_started;
+    uint32_t issues;
+} Soak;
+
+static void soak_report(Soak* soak, const Sim* sim, const char* issue, int32_t detail) {
+    if(soak->issues++ >= SOAK_REPORT_MAX) return;
+    char buf[64];
+    snprintf(
+        buf,
+        sizeof(buf),
+        "W %lu %s %ld clock=%lu\n",
+        (unsigned long)sim->tick,
+        issue,
+        (long)detail,
+        (unsigned long)now_ms(sim));
+    cmd_reply(soak->app, buf);
+}
+
+static void soak_on_event(void* ctx, const Sim* sim, const SimEvent* ev) {
+    Soak* soak = ctx;
+    uint32_t t = now_ms(sim);
+    if(ev->type == SimEvWindowOpened) {
+        soak->window_open = true;
+        soak->window_until_ms = t + ev->arg;
+    }
+    // A new boss legitimately closes any open window
+    if(ev->type == SimEvNewGame || ev->type == SimEvBossAdvanced) soak->window_open = false;
+    // These reschedule the AI on purpose
+    if(ev->type == SimEvNewGame || ev->type == SimEvBossAdvanced || ev->type == SimEvFightStart) {
+        soak->boss_started = true;
+    }
+    if(ev->type == SimEvKO && ev->who == SimFighterPlayer) soak->restart = true;
+    if(ev->type == SimEvMatchWon) soak->restart = true;
+}
+
+static void soak_check_fighter(Soak* soak, const Sim* sim, const Fighter* f, const char* issue) {
+    if(f->state == FighterStateIdle || f->state == FighterStateKO) return;
+    // The state should have ended on the tick its deadline was reached
+    int32_t late = (int32_t)(now_ms(sim) - f->state_until_ms);
+    if(late > TICK_MS) soak_report(soak, sim, issue, late);
+}
+
+static void soak_run(App* app, uint32_t seed, uint32_t start_ms, uint32_t ticks, uint8_t bot_idx) {
+    Soak soak = {.app = app};
+    Bot bot;
+    if(bot_idx != BOT_NONE) bot_init(&bot, bot_idx, seed);
+    Sim* sim = malloc(sizeof(Sim));
+    memset(sim, 0, sizeof(Sim));
+    sim->bosses = app->bosses;
+    sim->hitstop_ticks = app->sim.hitstop_ticks;
+    sim_subscribe(sim, soak_on_event, &soak);
+    // Soak runs the built-in AI, whose timers it checks
+    const AiBuiltinState* ai = (const AiBuiltinState*)sim->ai_state;
+    srand(seed);
+    sim_seed(sim, seed);
+    sim_reset(sim, start_ms);
+    reset_game(sim, 0);
+    for(uint32_t i = 0; i < ticks; i++) {
+        if(soak.restart) {
+            soak.restart = false;
+            soak.window_open = false;
+            reset_game(sim, 0);
+        }
+        if(bot_idx != BOT_NONE) {
+            bot_step(&bot, sim);
+        } else {
+            int r = rand() % 64;
+            if(r < 3) sim_input(sim, r);
+        }
+        uint32_t prev_action_ms = ai->next_action_ms;
+        soak.boss_started = false;
+        sim_tick(sim);
+        uint32_t t = now_ms(sim);
+        soak_check_fighter(&soak, sim, &sim->player, "stuck-player");
+        soak_check_fighter(&soak, sim, &sim->enemy, "stuck-enemy");
+        if(soak.window_open) {
+            if(time_reached(t, soak.window_until_ms)) {
+                soak.window_open = false;
+                if(enemy_is_vulnerable(sim)) soak_report(&soak, sim, "window-overrun", 0);
+            } else if(!enemy_is_vulnerable(sim)) {
+                soak_report(&soak, sim, "window-skipped", (int32_t)(soak.window_until_ms - t));
+                soak.window_open = false;
+            }
+        }
+        // An idle enemy decides on the tick its next action is due and never schedules past the max delay
+        const BossDef* b = &sim->bosses[sim->boss_index];
+        bool fighting = sim->enemy.state != FighterStateKO && sim->player.state != FighterStateKO &&
+                        !sim->script;
+        int32_t ahead = (int32_t)(ai->next_action_ms - t);
+        if(fighting && sim->enemy.state == FighterStateIdle && ahead <= 0) {
+            soak_report(&soak, sim, "ai-stall", ahead);
+        } else if(ahead > b->ai_base_delay + b->ai_rand_delay + 700) {
+            soak_report(&soak, sim, "ai-far", ahead);
+        } else if(
+            !soak.boss_started && ai->next_action_ms != prev_action_ms &&
+            !time_reached(t, prev_action_ms)) {
+            soak_report(&soak, sim, "ai-early", (int32_t)(prev_action_ms - t));
+        }
+    }
+    char buf[48];
+    snprintf(buf, sizeof(buf), "W done %lu %lu\n", (unsigned long)ticks, (unsigned long)soak.issues);
+    cmd_reply(app, buf);
+    free(sim);
+}
+
+// AI BOUTS
+// Headless fights of one backend against soak-style random play or a bot player, for comparing
+// backends and their cost without touching the live fight
+typedef struct {
+    bool over;
+    uint16_t boss_wins;
+    uint16_t player_wins;
+} Bout;
+
+static void bout_on_event(void* ctx, const Sim* sim, const SimEvent* ev) {
+    Bout* bout = ctx;
+    UNUSED(sim);
+    if(ev->type == SimEvKO && ev->who == SimFighterPlayer) {
+        bout->boss_wins++;
+        bout->over = true;
+    }
+    if(ev->type == SimEvMatchWon) {
+        bout->player_wins++;
+        bout->over = true;
+    }
+}
+
+static void ai_report(App* app, uint8_t idx) {
+    const AiSlot* slot = &app->ai_slots[idx];
+    uint32_t steps = slot->steps ? slot->steps : 1;
+    char buf[80];
+    snprintf(
+        buf,
+        sizeof(buf),
+        "B %u %s %lu %lu %lu %lu %lu\n",
+        idx,
+        slot->be->name,
+        (unsigned long)slot->be->budget_cycles,
+        (unsigned long)slot->steps,
+        (unsigned long)(slot->cyc_sum / steps),
+        (unsigned long)slot->cyc_max,
+        (unsigned long)slot->over);
+    cmd_reply(app, buf);
+}
+
+static void ai_bout_run(App* app, uint8_t idx, uint32_t seed, uint16_t fights, uint8_t bot_idx) {
+    Bout bout = {0};
+    Bot bot;
+    uint64_t bot_cyc = 0;
+    uint64_t tick_cyc = 0;
+    uint32_t ticks = 0;
+    uint16_t draws = 0;
+    Sim* sim = malloc(sizeof(Sim));
+    memset(sim, 0, sizeof(Sim));
+    sim->bosses = app->bosses;
+    sim->ai = &app->ai_slots[idx];
+    sim_subscribe(sim, bout_on_event, &bout);
+    srand(seed);
+    sim_seed(sim, seed);
+    if(bot_idx != BOT_NONE) bot_init(&bot, bot_idx, seed);
+    for(uint16_t f = 0; f < fights; f++) {
+        sim_reset(sim, 0);
+        reset_game(sim, 0);
+        bout.over = false;
+        while(!bout.over && sim->tick < AI_BOUT_MAX_TICKS) {
+            if(bot_idx != BOT_NONE) {
+                uint32_t c0 = FX_CYCCNT;
+                bot_step(&bot, sim);
+                uint32_t c1 = FX_CYCCNT;
+                sim_tick(sim);
+                bot_cyc += c1 - c0;
+                tick_cyc += FX_CYCCNT - c1;
+            } else {
+                int r = rand() % 64;
+                if(r < 3) sim_input(sim, r);
+                sim_tick(sim);
+            }
+        }
+        if(!bout.over) draws++;
+        ticks += sim->tick;
+    }
+    char buf[64];
+    snprintf(
+        buf,
+        sizeof(buf),
+        "B bout %u %u %u %u %lu\n",
+        fights,
+        bout.boss_wins,
+        bout.player_wins,
+        draws,
+        (unsigned long)(fights ? ticks / fights : 0));
+    cmd_reply(app, buf);
+    if(bot_idx != BOT_NONE) {
+        uint32_t n = ticks ? ticks : 1;
+        snprintf(
+            buf,
+            sizeof(buf),
+            "B bot %s %lu %lu %lu\n",
+            bot.p->name,
+            (unsigned long)(bot_cyc / n),
+            (unsigned long)(tick_cyc / n),
+            (unsigned long)bot.errors);
+        cmd_reply(app, buf);
+    }
+    ai_report(app, idx);
+    free(sim);
+}
+
+static void ai_cmd(App* app, char* args) {
+    char* p = args;
+    uint32_t idx = strtoul(p, &p, 10);
+    if(p == args) {
+        for(uint8_t i = 0; i < app->ai_count; i++) ai_report(app, i);
+        char buf[24];
+        snprintf(buf, sizeof(buf), "B done %u\n", app->ai_count);
+        cmd_reply(app, buf);
+        return;
+    }
+    if(idx >= app->ai_count) {
+        cmd_reply(app, "ERR\n");
+        return;
+    }
+    char* q = p;
+    uint32_t seed = strtoul(q, &q, 10);
+    if(q == p) {
+        app->ai_pick = idx;
+        cmd_reply(app, "OK\n");
+        return;
+    }
+    uint32_t fights = strtoul(q, &q, 10);
+    ai_bout_run(app, idx, seed, fights, bot_parse(q));
+}
+
+// STATE HASH
+// Gameplay state as a flat field list, so hashes never depend on struct layout or padding.
+// Visual-only state (tweens, animators) stays out.
+#define STATE_FIELDS 35
+
+// Shared by the live Fighter and anything with the same gameplay field names
+#define STATE_FIGHTER_FIELDS(v, n, f) \
+    do { \
+        v[n++] = (f).x; \
+        v[n++] = (f).y; \
+        v[n++] = (f).home_x; \
+        v[n++] = (f).state; \
+        v[n++] = (f).state_until_ms; \
+        v[n++] = (f).hp; \
+        v[n++] = (f).max_hp; \
+        v[n++] = (f).flash; \
+        v[n++] = (f).flash_next_ms; \
+        v[n++] = (f).dodge_dir; \
+        v[n++] = (f).pending_punch; \
+    } while(0)
+
+static uint8_t sim_state_fields(const Sim* sim, uint32_t* v) {
+    uint8_t n = 0;
+    v[n++] = sim->tick;
+    v[n++] = sim->clock_ms;
+    v[n++] = sim->boss_index;
+    v[n++] = sim->enemy_vulnerable_until_ms;
+    v[n++] = sim->ai_state[0];
+    v[n++] = sim->ai_state[1];
+    v[n++] = sim->enemy_walk_px;
+    v[n++] = sim->enemy_fall_px;
+    v[n++] = sim->freeze_ticks;
+    v[n++] = (sim->script == script_intro) ? 1 : (sim->script == script_knockdown) ? 2 : 0;
+    v[n++] = sim->script ? sim->script_state.i : 0;
+    v[n++] = sim->script ? sim->script_state.wait_until_ms : 0;
+    v[n++] = sim->rng;
+    STATE_FIGHTER_FIELDS(v, n, sim->player);
+    STATE_FIGHTER_FIELDS(v, n, sim->enemy);
+    return n;
+}
+
+// FNV-1a over the fields, little-endian
+static uint32_t state_hash(const uint32_t* v, uint8_t n) {
+    uint32_t h = 2166136261u;
+    for(uint8_t i = 0; i < n; i++) {
+        for(uint8_t b = 0; b < 4; b++) {
+            h ^= (v[i] >> (b * 8)) & 0xFF;
+            h *= 16777619u;
+        }
+    }
+    return h;
+}
+
+// REPLAY CORPUS
+// Seeded input streams for the live core: generated, never stored. Each run folds the per-tick
+// state hashes into one; the golden values pin the sim across compilers and targets.
+typedef struct {
+    uint32_t tick;
+    uint8_t key; // 0 punch, 1 dodge left, 2 dodge right
+} ReplayInput;
+
+// The inputs live with the owner: REPLAY_INPUTS_MAX of them for generated runs
+typedef struct {
+    uint32_t seed;
+    uint32_t clock0;
+    uint32_t ticks;
+    uint16_t n;
+    ReplayInput* in;
+} ReplayCase;
+
+static void replay_gen(ReplayCase* c, uint32_t seed, uint32_t ticks) {
+    uint32_t r = seed ? seed : 0x9E3779B9;
+#define REPLAY_NEXT() (r ^= r << 13, r ^= r >> 17, r ^= r << 5, r)
+    c->seed = seed;
+    c->ticks = ticks;
+    // A quarter of the runs start just below the clock wrap
+    c->clock0 = (REPLAY_NEXT() % 4 == 0) ? 0u - (REPLAY_NEXT() % 60000) : REPLAY_NEXT() % 100000;
+    c->n = 0;
+    uint32_t t = 0;
+    while(c->n < REPLAY_INPUTS_MAX) {
+        t += 10 + REPLAY_NEXT() % 300;
+        if(t >= ticks) break;
+        c->in[c->n++] = (ReplayInput){t, REPLAY_NEXT() % 3};
+    }
+#undef REPLAY_NEXT
+}
+
+// Fights restart on a loss or after the last boss, each side judged on its own state
+static bool replay_fight_over(FighterState player, FighterState enemy, bool scripted) {
+    return player == FighterStateKO || (enemy == FighterStateKO && !scripted);
+}
+
+// Inputs at tick i are applied before the step to i + 1
+static void replay_start(Sim* sim, const ReplayCase* c, const BossDef* bosses, uint16_t hitstop_ticks) {
+    memset(sim, 0, sizeof(Sim));
+    sim->bosses = bosses;
+    sim->hitstop_ticks = hitstop_ticks;
+    sim_seed(sim, c->seed);
+    sim_reset(sim, c->clock0);
+    reset_game(sim, 0);
+}
+
+// Heap scratch for a replay run, the app thread stack is small
+typedef struct {
+    Sim sim;
+    ReplayCase c;
+    ReplayInput in[REPLAY_INPUTS_MAX];
+    uint32_t v[STATE_FIELDS];
+} Replay;
+
+static uint32_t replay_hash(Replay* rp, const BossDef* bosses, uint16_t hitstop_ticks) {
+    Sim* sim = &rp->sim;
+    const ReplayCase* c = &rp->c;
+    uint32_t h = 2166136261u;
+    uint16_t next = 0;
+    replay_start(sim, c, bosses, hitstop_ticks);
+    for(uint32_t i = 0; i < c->ticks; i++) {
+        while(next < c->n && c->in[next].tick == i) sim_input(sim, c->in[next++].key);
+        if(replay_fight_over(sim->player.state, sim->enemy.state, sim->script != NULL)) reset_game(sim, 0);
+        sim_tick(sim);
+        h = (h ^ state_hash(rp->v, sim_state_fields(sim, rp->v))) * 16777619u;
+    }
+    return h;
+}
+
+// Generated on x86-64; the host/ build's ctest checks them there and on i386, which has the M4's
+// 32-bit long and pointers. Regenerate with "H <seed> <ticks> <hitstop>" only for an intended
+// gameplay change.
+typedef struct {
+    uint32_t seed;
+    uint32_t ticks;
+    uint16_t hitstop_ticks;
+    uint32_t hash;
+} ReplayGolden;
+
+static const ReplayGolden replay_golden[] = {
+    {1, 30000, 33, 0x47D1CAF7},
+    {2, 30000, 0, 0xECCD63B4},
+    {3, 30000, 33, 0xD9319FE1},
+    {4, 30000, 0, 0x121DC9DE},
+    {5, 30000, 33, 0x61F0C631},
+    {6, 30000, 0, 0x7B4BCA90},
+    {7, 30000, 33, 0xD57C54FB},
+    {8, 30000, 0, 0x4FD4A9CE},
+};
+
+// FLIGHT REPLAY
+// flight.bin back as a replay: the keyframe, then every input with its tick and age. The inputs are
+// re-run on a private Sim restored from the keyframe and checked against the recorded state
+// changes, so a dump that does not reproduce says so. Read straight off the card, like the stats.
+
+// Key names of ReplayInput.key in the text forms, shared with the D commands
+static const char* const replay_key_names[] = {"ok", "left", "right"};
+
+static void flight_cmd(App* app) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    FlightHeader h;
+    Sim* sim = malloc(sizeof(Sim));
+    FlightEntry* e = malloc(FLIGHT_ENTRIES * sizeof(FlightEntry));
+    memset(sim, 0, sizeof(Sim));
+    bool ok = storage_file_open(file, FLIGHT_PATH, FSAM_READ, FSOM_OPEN_EXISTING) &&
+              storage_file_read(file, &h, sizeof(h)) == sizeof(h) && h.magic == FLIGHT_MAGIC &&
+              h.version == FLIGHT_VERSION && h.sim_bytes == FLIGHT_SIM_BYTES && h.entries <= FLIGHT_ENTRIES &&
+              storage_file_read(file, sim, FLIGHT_SIM_BYTES) == FLIGHT_SIM_BYTES &&
+              storage_file_read(file, e, h.entries * sizeof(FlightEntry)) == h.entries * sizeof(FlightEntry);
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+    char buf[64];
+    if(!ok) {
+        cmd_reply(app, "J none\n");
+        free(e);
+        free(sim);
+        return;
+    }
+    // The pointers in the keyframe belonged to the run that wrote it
+    sim->bosses = h.table ? boss_table_active(app) : app->bosses;
+    sim->ai = (h.ai < app->ai_count) ? &app->ai_slots[h.ai] : NULL;
+    sim->script = (h.script == 1) ? script_intro : (h.script == 2) ? script_knockdown : NULL;
+    uint32_t key_tick = sim->tick;
+    snprintf(buf, sizeof(buf), "J %s %lu %lu %u %u\n", (h.reason == FlightStuck) ? "stuck" : "exit",
+        (unsigned long)key_tick, (unsigned long)now_ms(sim), sim->boss_index, h.entries);
+    cmd_reply(app, buf);
+    uint32_t want = flight_pack(sim);
+    uint32_t diverged = 0;
+    bool bad = false;
+    for(uint16_t i = 0; i < h.entries; i++) {
+        uint32_t t = key_tick + (uint16_t)(e[i].tick - (uint16_t)key_tick);
+        while(sim->tick != t) {
+            sim_tick(sim);
+            if(sim->tick != t && !bad && flight_pack(sim) != want) {
+                bad = true;
+                diverged = sim->tick;
+            }
+        }
+        if(e[i].kind < 3) {
+            snprintf(buf, sizeof(buf), "J in %lu %s %u\n", (unsigned long)t, replay_key_names[e[i].kind], e[i].arg);
+            sim_input_at(sim, e[i].kind, e[i].arg);
+        } else {
+            want = (e[i].kind & 0x3F) | e[i].arg << 8;
+            snprintf(buf, sizeof(buf), "J st %lu %u %u %u %u\n", (unsigned long)t, e[i].kind & 7,
+                e[i].arg & 0xF, (e[i].kind >> 3) & 7, e[i].arg >> 4);
+            if(!bad && flight_pack(sim) != want) {
+                bad = true;
+                diverged = t;
+            }
+        }
+        cmd_reply(app, buf);
+    }
+    if(bad) snprintf(buf, sizeof(buf), "J diverge %lu\n", (unsigned long)diverged);
+    else snprintf(buf, sizeof(buf), "J ok %lu\n", (unsigned long)(sim->tick - key_tick));
+    cmd_reply(app, buf);
+    free(e);
+    free(sim);
+}
+
+#ifdef BOX_DIFF
+// REFERENCE CORE
+// Frozen copy of the combat rules as they stood before the optimization work: plain state mutation,
+// no events, no tweens or animation. Do not touch it when changing the live core; the
+// differential runner below exists to prove the live core still matches it.
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t home_x;
+    FighterState state;
+    uint32_t state_until_ms;
+    uint8_t hp;
+    uint8_t max_hp;
+    bool flash;
+    uint32_t flash_next_ms;
+    int8_t dodge_dir;
+    bool pending_punch;
+} RefFighter;
+
+typedef struct RefSim RefSim;
+typedef bool (*RefScriptFn)(RefSim* ref);
+
+struct RefSim {
+    uint32_t tick;
+    uint32_t clock_ms;
+    RefFighter player;
+    RefFighter enemy;
+    uint8_t boss_index;
+    const BossDef* bosses;
+    uint32_t vulnerable_until_ms;
+    uint32_t next_action_ms;
+    uint32_t next_shuffle_ms;
+    RefScriptFn script;
+    Script script_state;
+    uint8_t fall_px;
+    uint8_t walk_px;
+    uint16_t hitstop_ticks;
+    uint16_t freeze_ticks;
+    uint32_t rng;
+};
+
+static bool ref_intro(RefSim* ref);
+static bool ref_knockdown(RefSim* ref);
+
+static uint32_t ref_rand(RefSim* ref) {
+    uint32_t x = ref->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    ref->rng = x;
+    return x;
+}
+
+static void ref_set_state(RefFighter* f, FighterState st, uint32_t duration_ms, uint32_t t) {
+    f->state = st;
+    f->state_until_ms = t + duration_ms;
+}
+
+static void ref_update_state(RefFighter* f, uint32_t t) {
+    if(f->state == FighterStateKO) return;
+    if(f->state == FighterStateTelegraph && time_reached(t, f->flash_next_ms)) {
+        f->flash = !f->flash;
+        f->flash_next_ms = t + 80;
+    }
+    if(f->state != FighterStateIdle && time_reached(t, f->state_until_ms)) {
+        if(f->state == FighterStateDodging) f->x = f->home_x;
+        f->state = FighterStateIdle;
+    }
+}
+
+static void ref_script_start(RefSim* ref, RefScriptFn fn) {
+    ref->script = fn;
+    ref->script_state.line = 0;
+}
+
+static void ref_start_boss(RefSim* ref, uint8_t idx) {
+    uint32_t t = ref->clock_ms;
+    int16_t home = (SCREEN_W / 2) - (FIGHTER_W / 2);
+    ref->boss_index = idx;
+    ref->player.home_x = home; ref->player.x = home; ref->player.y = PLAYER_Y;
+    ref->player.hp = MAX_HP; ref->player.max_hp = MAX_HP;
+    ref_set_state(&ref->player, FighterStateIdle, 0, t);
+    ref->enemy.home_x = home; ref->enemy.x = home; ref->enemy.y = ENEMY_Y;
+    ref->enemy.hp = ref->bosses[idx].enemy_hp; ref->enemy.max_hp = ref->bosses[idx].enemy_hp;
+    ref_set_state(&ref->enemy, FighterStateIdle, 0, t);
+    ref->enemy.pending_punch = false;
+    ref->vulnerable_until_ms = t;
+    ref->next_shuffle_ms = t;
+    ref->next_action_ms = t + 700;
+    ref_script_start(ref, ref_intro);
+}
+
+static void ref_reset(RefSim* ref, const BossDef* bosses, uint32_t seed, uint32_t clock_ms, uint16_t hitstop_ticks) {
+    memset(ref, 0, sizeof(RefSim));
+    ref->bosses = bosses;
+    ref->rng = seed ? seed : 0x9E3779B9;
+    ref->clock_ms = clock_ms;
+    ref->vulnerable_until_ms = clock_ms;
+    ref->next_action_ms = clock_ms;
+    ref->next_shuffle_ms = clock_ms;
+    ref->hitstop_ticks = hitstop_ticks;
+}
+
+static void ref_hit(RefSim* ref, RefFighter* f, uint8_t dmg) {
+    f->hp = (f->hp > dmg) ? (f->hp - dmg) : 0;
+    ref_set_state(f, FighterStateHitStun, HIT_STUN_MS, ref->clock_ms);
+    ref->freeze_ticks = ref->hitstop_ticks;
+}
+
+static void ref_enemy_punch(RefSim* ref) {
+    const BossDef* b = &ref->bosses[ref->boss_index];
+    uint32_t t = ref->clock_ms;
+    ref_set_state(&ref->enemy, FighterStatePunching, b->punch_ms, t);
+    if(ref->player.state == FighterStateDodging) {
+        ref->vulnerable_until_ms = t + b->vulnerable_ms;
+        return;
+    }
+    if(abs(ref->player.x - ref->enemy.x) <= PUNCH_RANGE && ref->player.state != FighterStateHitStun) {
+        ref_hit(ref, &ref->player, 1);
+        if(ref->player.hp == 0) ref->player.state = FighterStateKO;
+    }
+}
+
+static void ref_player_punch(RefSim* ref) {
+    if(ref->player.state != FighterStateIdle || ref->script) return;
+    const BossDef* b = &ref->bosses[ref->boss_index];
+    uint32_t t = ref->clock_ms;
+    ref_set_state(&ref->player, FighterStatePunching, b->punch_ms, t);
+    if(abs(ref->player.x - ref->enemy.x) > PUNCH_RANGE) return;
+    bool hittable = !time_reached(t, ref->vulnerable_until_ms) ||
+                    (b->telegraph_hittable && ref->enemy.state == FighterStateTelegraph);
+    if(!hittable) return;
+    ref_hit(ref, &ref->enemy, b->player_damage);
+    if(ref->enemy.hp == 0) {
+        ref->enemy.state = FighterStateKO;
+        ref_script_start(ref, ref_knockdown);
+    }
+}
+
+static void ref_dodge(RefSim* ref, int8_t dir) {
+    RefFighter* f = &ref->player;
+    if(f->state != FighterStateIdle || ref->script) return;
+    f->dodge_dir = dir;
+    f->x = f->home_x + (dir * PLAYER_DODGE_OFFSET);
+    if(f->x < RING_LEFT + 3) f->x = RING_LEFT + 3;
+    if(f->x > RING_RIGHT - 3 - FIGHTER_W) f->x = RING_RIGHT - 3 - FIGHTER_W;
+    ref_set_state(f, FighterStateDodging, 220, ref->clock_ms);
+}
+
+static void ref_ai(RefSim* ref) {
+    uint32_t t = ref->clock_ms;
+    if(ref->script) return;
+    if(ref->enemy.state == FighterStateKO || ref->player.state == FighterStateKO) return;
+    const BossDef* b = &ref->bosses[ref->boss_index];
+    if(ref->enemy.state == FighterStateIdle && time_reached(t, ref->next_shuffle_ms)) {
+        if((ref_rand(ref) % 4) == 0) {
+            ref->enemy.x += (ref_rand(ref) & 1) ? +1 : -1;
+            if(ref->enemy.x < RING_LEFT + 3) ref->enemy.x = RING_LEFT + 3;
+            if(ref->enemy.x > RING_RIGHT - 3 - FIGHTER_W) ref->enemy.x = RING_RIGHT - 3 - FIGHTER_W;
+        }
+        ref->next_shuffle_ms = t + 350 + (ref_rand(ref) % 400);
+    }
+    if(!time_reached(t, ref->next_action_ms)) return;
+    if(ref->enemy.state == FighterStateIdle) {
+        int dx = abs(ref->player.x - ref->enemy.x);
+        int roll = ref_rand(ref) % 100;
+        if(roll < (dx <= PUNCH_RANGE ? b->punch_chance_near : b->punch_chance_far)) {
+            ref_set_state(&ref->enemy, FighterStateTelegraph, b->telegraph_ms, t);
+            ref->enemy.flash = true;
+            ref->enemy.flash_next_ms = t + 80;
+            ref->enemy.pending_punch = true;
+        }
+        ref->next_action_ms = t + b->ai_base_delay + (ref_rand(ref) % b->ai_rand_delay);
+    }
+}
+
+static bool ref_intro(RefSim* ref) {
+    Script* sc = &ref->script_state;
+    uint32_t t = ref->clock_ms;
+    SCRIPT_BEGIN(sc);
+    for(ref->walk_px = WALK_IN_PX; ref->walk_px > 0; ref->walk_px -= 2) {
+        SCRIPT_WAIT_MS(sc, t, WALK_IN_STEP_MS);
+    }
+    SCRIPT_WAIT_MS(sc, t, 400);
+    ref->next_action_ms = t + 300;
+    SCRIPT_END(sc);
+}
+
+static bool ref_knockdown(RefSim* ref) {
+    Script* sc = &ref->script_state;
+    uint32_t t = ref->clock_ms;
+    SCRIPT_BEGIN(sc);
+    for(ref->fall_px = 0; ref->fall_px < KO_FALL_PX; ref->fall_px++) {
+        SCRIPT_WAIT_MS(sc, t, KO_FALL_STEP_MS);
+    }
+    SCRIPT_WAIT_MS(sc, t, 300);
+    for(sc->i = 1; sc->i <= KO_COUNT_TO; sc->i++) {
+        SCRIPT_WAIT_MS(sc, t, KO_COUNT_MS);
+    }
+    ref->fall_px = 0;
+    if(ref->boss_index < 2) ref_start_boss(ref, ref->boss_index + 1);
+    SCRIPT_END(sc);
+}
+
+static void ref_tick(RefSim* ref) {
+    if(ref->freeze_ticks > 0) {
+        ref->freeze_ticks--;
+        ref->tick++;
+        return;
+    }
+    ref->tick++;
+    ref->clock_ms += TICK_MS;
+    if(ref->script) {
+        RefScriptFn fn = ref->script;
+        if(fn(ref) && ref->script == fn) ref->script = NULL;
+    }
+    ref_update_state(&ref->player, ref->clock_ms);
+    ref_update_state(&ref->enemy, ref->clock_ms);
+    if(ref->enemy.pending_punch && ref->enemy.state == FighterStateIdle) {
+        ref->enemy.pending_punch = false;
+        ref_enemy_punch(ref);
+    }
+    ref_ai(ref);
+}
+
+static uint8_t ref_state_fields(const RefSim* ref, uint32_t* v) {
+    uint8_t n = 0;
+    v[n++] = ref->tick;
+    v[n++] = ref->clock_ms;
+    v[n++] = ref->boss_index;
+    v[n++] = ref->vulnerable_until_ms;
+    v[n++] = ref->next_action_ms;
+    v[n++] = ref->next_shuffle_ms;
+    v[n++] = ref->walk_px;
+    v[n++] = ref->fall_px;
+    v[n++] = ref->freeze_ticks;
+    v[n++] = (ref->script == ref_intro) ? 1 : (ref->script == ref_knockdown) ? 2 : 0;
+    v[n++] = ref->script ? ref->script_state.i : 0;
+    v[n++] = ref->script ? ref->script_state.wait_until_ms : 0;
+    v[n++] = ref->rng;
+    STATE_FIGHTER_FIELDS(v, n, ref->player);
+    STATE_FIGHTER_FIELDS(v, n, ref->enemy);
+    return n;
+}
+
+// DIFFERENTIAL RUNNER
+// Random seeded input streams (or a loaded replay) go to a private live Sim and to the reference
+// core in lockstep; the field hashes are compared every tick. A divergent stream is shrunk by
+// delta debugging: chunks of inputs are dropped while the divergence persists, halving the chunks
+// whenever none can go, then the gaps between inputs are closed up. Trials share the accepted
+// case's prefix, so each one resumes from the last keyframe before its first changed input
+// instead of from tick 0.
+
+// Field names for divergence reports, in sim_state_fields order
+static const char* const state_field_names[STATE_FIELDS] = {
+    "tick", "clock", "boss", "vuln", "next_action", "next_shuffle", "walk", "fall", "freeze",
+    "script", "script_i", "script_wait", "rng",
+    "p.x", "p.y", "p.home", "p.state", "p.until", "p.hp", "p.max_hp", "p.flash", "p.flash_next", "p.dodge", "p.pending",
+    "e.x", "e.y", "e.home", "e.state", "e.until", "e.hp", "e.max_hp", "e.flash", "e.flash_next", "e.dodge", "e.pending",
+};
+
+typedef struct {
+    uint32_t tick; // state at the start of this tick, before its inputs
+    uint16_t next; // first input not applied yet
+    Sim sim;
+    RefSim ref;
+} DiffKey;
+
+struct Diff {
+    Sim sim;
+    RefSim ref;
+    ReplayCase c;
+    ReplayCase trial;
+    uint32_t live[STATE_FIELDS];
+    uint32_t want[STATE_FIELDS];
+    uint32_t div_tick;
+    uint8_t div_field;
+    // Keyframes of c, in tick order
+    DiffKey key[DIFF_KEYS];
+    uint8_t keys;
+    uint32_t key_every;
+    uint32_t trials;
+    uint64_t ticks_run;
+    uint64_t ticks_skipped;
+    // Inputs of c, then of trial, cap each
+    uint16_t cap;
+    ReplayInput in[];
+};
+
+static Diff* diff_alloc(uint16_t cap) {
+    Diff* d = malloc(sizeof(Diff) + 2 * cap * sizeof(ReplayInput));
+    d->cap = cap;
+    d->c.in = d->in;
+    d->trial.in = d->in + cap;
+    return d;
+}
+
+static void diff_input(Diff* d, uint8_t key) {
+    sim_input(&d->sim, key);
+    if(key == 0) ref_player_punch(&d->ref);
+    else ref_dodge(&d->ref, key == 1 ? -1 : +1);
+}
+
+static bool diff_compare(Diff* d) {
+    uint8_t n = sim_state_fields(&d->sim, d->live);
+    ref_state_fields(&d->ref, d->want);
+    if(state_hash(d->live, n) == state_hash(d->want, n)) return false;
+    for(d->div_field = 0; d->div_field < n - 1; d->div_field++) {
+        if(d->live[d->div_field] != d->want[d->div_field]) break;
+    }
+    d->div_tick = d->sim.tick;
+    return true;
+}
+
+// From keyframe k, or from tick 0 when k < 0. With record set the keyframes after k are retaken for c.
+static bool diff_run_from(
+    Diff* d,
+    const ReplayCase* c,
+    int8_t k,
+    bool record,
+    const BossDef* bosses,
+    uint16_t hitstop_ticks) {
+    Sim* sim = &d->sim;
+    uint32_t i = 0;
+    uint16_t next = 0;
+    if(k < 0) {
+        replay_start(sim, c, bosses, hitstop_ticks);
+        ref_reset(&d->ref, bosses, c->seed, c->clock0, hitstop_ticks);
+        ref_start_boss(&d->ref, 0);
+        if(diff_compare(d)) return true;
+    } else {
+        *sim = d->key[k].sim;
+        d->ref = d->key[k].ref;
+        i = d->key[k].tick;
+        next = d->key[k].next;
+        d->ticks_skipped += i;
+    }
+    if(record) d->keys = k + 1;
+    for(; i < c->ticks; i++) {
+        if(record && i >= (uint32_t)d->keys * d->key_every + d->key_every && d->keys < DIFF_KEYS) {
+            DiffKey* key = &d->key[d->keys++];
+            key->tick = i;
+            key->next = next;
+            key->sim = *sim;
+            key->ref = d->ref;
+        }
+        while(next < c->n && c->in[next].tick == i) diff_input(d, c->in[next++].key);
+        if(replay_fight_over(sim->player.state, sim->enemy.state, sim->script != NULL)) reset_game(sim, 0);
+        if(replay_fight_over(d->ref.player.state, d->ref.enemy.state, d->ref.script != NULL)) ref_start_boss(&d->ref, 0);
+        sim_tick(sim);
+        ref_tick(&d->ref);
+        d->ticks_run++;
+        if(diff_compare(d)) return true;
+    }
+    return false;
+}
+
+static bool diff_run(Diff* d, const ReplayCase* c, const BossDef* bosses, uint16_t hitstop_ticks) {
+    return diff_run_from(d, c, -1, false, bosses, hitstop_ticks);
+}
+
+// Inputs at tick i act on the step to i + 1, anything at or after the divergence cannot matter
+static void diff_cut(Diff* d) {
+    ReplayCase* c = &d->c;
+    c->ticks = d->div_tick;
+    while(c->n > 0 && c->in[c->n - 1].tick >= c->ticks) c->n--;
+}
+
+// Last keyframe of c that t reaches unchanged: every input before its tick is the same in both
+static int8_t diff_resume_key(const Diff* d, const ReplayCase* t) {
+    const ReplayCase* c = &d->c;
+    uint16_t j = 0;
+    while(j < c->n && j < t->n && c->in[j].tick == t->in[j].tick && c->in[j].key == t->in[j].key) j++;
+    uint32_t same = c->ticks;
+    if(j < c->n && c->in[j].tick < same) same = c->in[j].tick;
+    if(j < t->n && t->in[j].tick < same) same = t->in[j].tick;
+    int8_t k = d->keys - 1;
+    while(k >= 0 && d->key[k].tick > same) k--;
+    return k;
+}
+
+// Header and inputs; dst keeps its own input storage
+static void replay_copy(ReplayCase* dst, const ReplayCase* src) {
+    ReplayInput* in = dst->in;
+    *dst = *src;
+    dst->in = in;
+    memcpy(in, src->in, src->n * sizeof(ReplayInput));
+}
+
+static void diff_trial_begin(Diff* d) {
+    replay_copy(&d->trial, &d->c);
+}
+
+// A trial that still diverges becomes the case; its keyframes past the shared prefix are retaken
+static bool diff_try(Diff* d, const BossDef* bosses, uint16_t hitstop_ticks) {
+    d->trials++;
+    int8_t k = diff_resume_key(d, &d->trial);
+    if(!diff_run_from(d, &d->trial, k, false, bosses, hitstop_ticks)) return false;
+    replay_copy(&d->c, &d->trial);
+    diff_run_from(d, &d->c, k, true, bosses, hitstop_ticks);
+    diff_cut(d);
+    return true;
+}
+
+static void diff_minimize(Diff* d, const BossDef* bosses, uint16_t hitstop_ticks) {
+    ReplayCase* c = &d->c;
+    diff_cut(d);
+    d->key_every = c->ticks / (DIFF_KEYS + 1) + 1;
+    d->trials = 0;
+    d->ticks_run = d->ticks_skipped = 0;
+    diff_run_from(d, c, -1, true, bosses, hitstop_ticks);
+    // Drop one chunk of n / gran inputs at a time, finer when none can go
+    uint16_t gran = 2;
+    while(c->n > 0) {
+        uint16_t size = (c->n + gran - 1) / gran;
+        bool dropped = false;
+        for(uint16_t start = 0; start < c->n;) {
+            uint16_t len = (c->n - start < size) ? c->n - start : size;
+            diff_trial_begin(d);
+            memmove(&d->trial.in[start], &d->trial.in[start + len], (c->n - start - len) * sizeof(ReplayInput));
+            d->trial.n -= len;
+            if(diff_try(d, bosses, hitstop_ticks)) dropped = true;
+            else start += len;
+        }
+        if(dropped) {
+            if(gran > 2) gran--;
+        } else if(size == 1) {
+            break;
+        } else {
+            gran = (gran * 2 < c->n) ? gran * 2 : c->n;
+        }
+    }
+    // Then the gaps: pull each input and everything after it earlier, halving the pull until the
+    // divergence survives it
+    for(uint16_t k = 0; k < c->n; k++) {
+        uint32_t floor = k ? c->in[k - 1].tick : 0;
+        for(uint32_t pull = c->in[k].tick - floor; pull > 0 && k < c->n; pull /= 2) {
+            diff_trial_begin(d);
+            for(uint16_t j = k; j < d->trial.n; j++) d->trial.in[j].tick -= pull;
+            if(diff_try(d, bosses, hitstop_ticks)) break;
+        }
+    }
+    // Leave d describing the minimized case
+    diff_run(d, c, bosses, hitstop_ticks);
+}
+
+static void diff_report(App* app, Diff* d, uint16_t hitstop_ticks) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "D diverge %lu tick %lu %s live %ld ref %ld\n",
+        (unsigned long)d->c.seed, (unsigned long)d->div_tick, state_field_names[d->div_field],
+        (long)d->live[d->div_field], (long)d->want[d->div_field]);
+    cmd_reply(app, buf);
+    diff_minimize(d, app->bosses, hitstop_ticks);
+    snprintf(buf, sizeof(buf), "D min %lu %llu %llu\n", (unsigned long)d->trials,
+        (unsigned long long)d->ticks_run, (unsigned long long)d->ticks_skipped);
+    cmd_reply(app, buf);
+    snprintf(buf, sizeof(buf), "D repro %lu clock %lu ticks %lu inputs %u first %s at %lu\n",
+        (unsigned long)d->c.seed, (unsigned long)d->c.clock0, (unsigned long)d->c.ticks, d->c.n,
+        state_field_names[d->div_field], (unsigned long)d->div_tick);
+    cmd_reply(app, buf);
+    for(uint16_t i = 0; i < d->c.n; i++) {
+        snprintf(buf, sizeof(buf), "D in %lu %s\n", (unsigned long)d->c.in[i].tick, replay_key_names[d->c.in[i].key]);
+        cmd_reply(app, buf);
+    }
+}
+
+static void diff_cmd(App* app, uint32_t seed, uint32_t runs, uint32_t ticks) {
+    Diff* d = diff_alloc(REPLAY_INPUTS_MAX);
+    uint16_t hitstop_ticks = app->sim.hitstop_ticks;
+    char buf[24];
+    uint32_t r;
+    for(r = 0; r < runs; r++) {
+        replay_gen(&d->c, seed + r, ticks);
+        if(diff_run(d, &d->c, app->bosses, hitstop_ticks)) break;
+    }
+    if(r == runs) {
+        snprintf(buf, sizeof(buf), "D ok %lu\n", (unsigned long)runs);
+        cmd_reply(app, buf);
+    } else {
+        diff_report(app, d, hitstop_ticks);
+    }
+    free(d);
+}
+
+// A replay from a report, in the form "D repro" prints it:
+//   D case <seed> <clock> <ticks>, then D in <tick> <key> per input in tick order, then D run
+static void diff_load_cmd(App* app, char* p) {
+    while(*p == ' ') p++;
+    if(!strncmp(p, "case", 4)) {
+        if(!app->diff) app->diff = diff_alloc(REPLAY_CASE_MAX);
+        ReplayCase* c = &app->diff->c;
+        p += 4;
+        c->seed = strtoul(p, &p, 10);
+        c->clock0 = strtoul(p, &p, 10);
+        c->ticks = strtoul(p, NULL, 10);
+        c->n = 0;
+        cmd_reply(app, "OK\n");
+        return;
+    }
+    ReplayCase* c = app->diff ? &app->diff->c : NULL;
+    if(c && !strncmp(p, "in", 2)) {
+        uint32_t tick = strtoul(p + 2, &p, 10);
+        while(*p == ' ') p++;
+        uint8_t key = 0;
+        while(key < COUNT_OF(replay_key_names) && strncmp(p, replay_key_names[key], strlen(replay_key_names[key]))) key++;
+        if(c->n == app->diff->cap || key == COUNT_OF(replay_key_names) || (c->n && tick < c->in[c->n - 1].tick)) {
+            cmd_reply(app, "ERR\n");
+            return;
+        }
+        c->in[c->n++] = (ReplayInput){tick, key};
+        cmd_reply(app, "OK\n");
+        return;
+    }
+    if(c && !strncmp(p, "run", 3)) {
+        uint16_t hitstop_ticks = app->sim.hitstop_ticks;
+        if(diff_run(app->diff, c, app->bosses, hitstop_ticks)) diff_report(app, app->diff, hitstop_ticks);
+        else cmd_reply(app, "D ok 1\n");
+        free(app->diff);
+        app->diff = NULL;
+        return;
+    }
+    cmd_reply(app, "ERR\n");
+}
+#endif
+
+// H: check every golden run; H <seed> <ticks> <hitstop>: print one run's hash
+static void replay_cmd(App* app, char* args) {
+    Replay* rp = malloc(sizeof(Replay));
+    rp->c.in = rp->in;
+    char buf[64];
+    char* p = args;
+    uint32_t seed = strtoul(p, &p, 10);
+    if(p != args) {
+        uint32_t ticks = strtoul(p, &p, 10);
+        uint16_t hitstop_ticks = strtoul(p, NULL, 10);
+        replay_gen(&rp->c, seed, ticks);
+        snprintf(buf, sizeof(buf), "H %lu %lu %u 0x%08lX\n", (unsigned long)seed, (unsigned long)ticks,
+            hitstop_ticks, (unsigned long)replay_hash(rp, app->bosses, hitstop_ticks));
+        cmd_reply(app, buf);
+        free(rp);
+        return;
+    }
+    uint8_t fails = 0;
+    for(uint8_t i = 0; i < COUNT_OF(replay_golden); i++) {
+        const ReplayGolden* g = &replay_golden[i];
+        replay_gen(&rp->c, g->seed, g->ticks);
+        uint32_t h = replay_hash(rp, app->bosses, g->hitstop_ticks);
+        if(h == g->hash) continue;
+        fails++;
+        snprintf(buf, sizeof(buf), "H fail %lu got 0x%08lX want 0x%08lX\n", (unsigned long)g->seed,
+            (unsigned long)h, (unsigned long)g->hash);
+        cmd_reply(app, buf);
+    }
+    snprintf(buf, sizeof(buf), "H done %u %u\n", (unsigned)COUNT_OF(replay_golden), fails);
+    cmd_reply(app, buf);
+    free(rp);
+}
+
+static void cmd_exec(App* app, char* line) {
+    char buf[96];
+    switch(line[0]) {
+    case 'N': {
+        char* p = line + 1;
+        sim_seed(&app->sim, strtoul(p, &p, 10));
+        app->cmd_driven = true;
+        app->cmd_inject_count = 0;
+        sim_reset(&app->sim, strtoul(p, NULL, 10));
+        app->start_boss = 0;
+        app->time_attack = false;
+        scene_switch(app, SceneFight);
+        cmd_reply(app, "OK\n");
+        break;
+    }
+    case 'B':
+        ai_cmd(app, line + 1);
+        break;
+    case 'W': {
+        char* p = line + 1;
+        uint32_t seed = strtoul(p, &p, 10);
+        uint32_t start_ms = strtoul(p, &p, 10);
+        uint32_t ticks = strtoul(p, &p, 10);
+        soak_run(app, seed, start_ms, ticks, bot_parse(p));
+        break;
+    }
+    case 'H':
+        replay_cmd(app, line + 1);
+        break;
+    case 'J':
+        flight_cmd(app);
+        break;
+    case 'R': {
+        Ghost* g = app->ghost;
+        uint32_t steps = (g && g->steps) ? g->steps : 1;
+        snprintf(
+            buf,
+            sizeof(buf),
+            "R %u %u %lu %lu %lu %lu %lu\n",
+            (unsigned)sizeof(Ghost),
+            (unsigned)sizeof(GhostRecord),
+            (unsigned long)(g ? g->steps : 0),
+            (unsigned long)(g ? g->step_cyc / steps : 0),
+            (unsigned long)(g ? g->step_cyc_max : 0),
+            (unsigned long)(g ? g->underruns : 0),
+            (unsigned long)(g ? g->refills : 0));
+        cmd_reply(app, buf);
+        break;
+    }
+    case 'L': {
+        const InputLatency* l = &app->input_lat;
+        uint32_t n = l->count ? l->count : 1;
+        snprintf(
+            buf,
+            sizeof(buf),
+            "L %lu %lu %lu %lu %lu %lu %lu\n",
+            (unsigned long)l->count,
+            (unsigned long)(l->queue_ms_sum / n),
+            (unsigned long)l->queue_ms_max,
+            (unsigned long)(l->age_ms_sum / n),
+            (unsigned long)l->age_ms_max,
+            (unsigned long)l->clamped,
+            (unsigned long)l->saved);
+        cmd_reply(app, buf);
+        break;
+    }
+#ifdef BOX_DIFF
+    case 'D': {
+        char* p = line + 1;
+        uint32_t seed = strtoul(p, &p, 10);
+        if(p == line + 1) {
+            diff_load_cmd(app, p);
+            break;
+        }
+        uint32_t runs = strtoul(p, &p, 10);
+        diff_cmd(app, seed, runs, strtoul(p, NULL, 10));
+        break;
+    }
+#endif
+    case 'K': {
+        char* p = line + 1;
+        CmdInject in;
+        in.tick = strtoul(p, &p, 10);
+        while(*p == ' ') p++;
+        if(!cmd_parse_key(p, &in.key) || app->cmd_inject_count >= CMD_INJECT_MAX) {
+            cmd_reply(app, "ERR\n");
+            break;
+        }
+        while(*p && *p != ' ') p++;
+        while(*p == ' ') p++;
+        in.press = (*p == 'p');
+        app->cmd_inject[app->cmd_inject_count++] = in;
+        cmd_reply(app, "OK\n");
+        break;
+    }
+    case 'S':
+        app->cmd_driven = true;
+        cmd_step(app, strtoul(line + 1, NULL, 10));
+        snprintf(buf, sizeof(buf), "T %lu\n", (unsigned long)app->sim.tick);
+        cmd_reply(app, buf);
+        break;
+    case 'Q':
+        cmd_query(app);
+        break;
+    case 'F':
+        app->cmd_fb_req = true;
+        app_request_frame(app);
+        break;
+    case 'G':
+        app->cmd_driven = false;
+        cmd_reply(app, "OK\n");
+        break;
+    case 'A':
+        term_start(app);
+        break;
+    case 'P':
+        for(uint8_t i = 0; i < PowerPhaseCount; i++) {
+            const PowerCounters* c = &app->power[i];
+            snprintf(
+                buf,
+                sizeof(buf),
+                "P %u %lu %lu %lu %lu %lu %lu %lu\n",
+                i,
+                (unsigned long)c->elapsed_ms,
+                (unsigned long)c->wakeups,
+                (unsigned long)c->updates,
+                (unsigned long)c->frames,
+                (unsigned long)c->sd_writes,
+                (unsigned long)c->vibro_cues,
+                (unsigned long)power_estimate_ua(c));
+            cmd_reply(app, buf);
+        }
+        break;
+    case 'C':
+        snprintf(
+            buf,
+            sizeof(buf),
+            "C %lu %lu %lu %lu %lu\n",
+            (unsigned long)app->cue_played,
+            (unsigned long)app->cue_stale,
+            (unsigned long)app->cue_dropped,
+            (unsigned long)(app->cue_played ? app->cue_offset_sum_ms / app->cue_played : 0),
+            (unsigned long)app->cue_offset_max_ms);
+        cmd_reply(app, buf);
+        break;
+    case 'E':
+        app->cmd_echo = (strtoul(line + 1, NULL, 10) != 0);
+        cmd_reply(app, "OK\n");
+        break;
+    case 'X': {
+        char* p = line + 1;
+        unsigned long on = strtoul(p, &p, 10);
+        if(p != line + 1) {
+            furi_mutex_acquire(app->mutex, FuriWaitForever);
+            app->fx_bench = (on != 0);
+            app->fx_frames = 0;
+            app->fx_draw_cyc = 0;
+            app->fx_offset_cyc = 0;
+            app->fx_post_cyc = 0;
+            app->fx_post_max_cyc = 0;
+            furi_mutex_release(app->mutex);
+            cmd_reply(app, "OK\n");
+            break;
+        }
+        uint32_t n = app->fx_frames ? app->fx_frames : 1;
+        snprintf(
+            buf,
+            sizeof(buf),
+            "X %lu %lu %lu %lu %lu\n",
+            (unsigned long)app->fx_frames,
+            (unsigned long)(app->fx_draw_cyc / n),
+            (unsigned long)(app->fx_offset_cyc / n),
+            (unsigned long)(app->fx_post_cyc / n),
+            (unsigned long)app->fx_post_max_cyc);
+        cmd_reply(app, buf);
+        break;
+    }
+    default:
+        cmd_reply(app, "ERR\n");
+        break;
+    }
+}
+
+static void cmd_on_event(void* ctx, const Sim* sim, const SimEvent* ev) {
+    App* app = ctx;
+    if(!app->cmd_echo) return;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "V %lu %u %u %d\n", (unsigned long)sim->tick, ev->type, ev->who, ev->arg);
+    cmd_reply(app, buf);
+}
+
+static void cmd_poll(App* app) {
+    uint8_t buf[32];
+    size_t n;
+    while((n = furi_stream_buffer_receive(app->cmd_rx, buf, sizeof(buf), 0)) > 0) {
+        for(size_t i = 0; i < n; i++) {
+            char c = buf[i];
+            if(app->term_on) {
+                term_key(app, c);
+                continue;
+            }
+            if(c == '\r') continue;
+            if(c == '\n') {
+                app->cmd_line[app->cmd_len] = '\0';
+                if(app->cmd_len > 0) cmd_exec(app, app->cmd_line);
+                app->cmd_len = 0;
+            } else if(app->cmd_len < CMD_LINE_MAX - 1) {
+                app->cmd_line[app->cmd_len++] = c;
+            }
+        }
+    }
+    if(app->cmd_fb_ready) {
+        app->cmd_fb_ready = false;
+        if(app->term_on) term_redraw(app);
+        else cmd_dump_fb(app);
+    }
+}
+#else
+static void cmd_open(App* app) {
+    UNUSED(app);
+}
+
+static void cmd_close(App* app) {
+    UNUSED(app);
+}
+
+static void cmd_poll(App* app) {
+    UNUSED(app);
+}
+#endif
+
+int32_t box_flipper_app(void* p) {
+    UNUSED(p);
+    App* app = malloc(sizeof(App));
+    memset(app, 0, sizeof(App));
+    app->sprite_cache[SimFighterPlayer].id = SprCount;
+    app->sprite_cache[SimFighterEnemy].id = SprCount;
+    app->input_queue = furi_message_queue_alloc(8, sizeof(InputEventWrap));
+    app->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    init_bosses(app);
+    settings_load(app);
+    ai_load(app);
+    cue_start(app);
+    io_start(app);
+    app->sim.bosses = app->bosses;
+    sim_subscribe(&app->sim, app_on_event, app);
+    sim_subscribe(&app->sim, stats_on_event, app);
+    sim_subscribe(&app->sim, cue_on_event, app);
+#ifdef BOX_CMD_CDC
+    sim_subscribe(&app->sim, cmd_on_event, app);
+#endif
+    sim_subscribe(&app->sim, ta_on_event, app);
+    sim_subscribe(&app->sim, lifetime_on_event, app);
+    app->scene = SceneTitle;
+    scene_handlers[SceneTitle].on_enter(app);
+    app->gui = furi_record_open(RECORD_GUI);
+    app->view_port = view_port_alloc();
+    view_port_draw_callback_set(app->view_port, app_draw, app);
+    view_port_input_callback_set(app->view_port, input_cb, app);
+    gui_add_view_port(app->gui, app->view_port, GuiLayerFullscreen);
+    cmd_open(app);
+
+    app->running = true;
+    uint32_t last_frame = furi_get_tick();
+    uint32_t last_tick = last_frame;
+    uint32_t last_wake = last_frame;
+    while(app->running) {
+        uint32_t wake = furi_get_tick();
+        PowerCounters* pc = power_now(app);
+        pc->wakeups++;
+        pc->elapsed_ms += wake - last_wake;
+        last_wake = wake;
+        InputEventWrap e;
+        while(furi_message_queue_get(app->input_queue, &e, 0) == FuriStatusOk) {
+            if(e.event.type == InputTypePress) app->key_press_ms[e.event.key] = e.clock_ms;
+            if(e.event.type != InputTypeShort) continue;
+            // Driven by the command channel: only Back still reaches the scenes
+            if(app->cmd_driven && e.event.key != InputKeyBack) continue;
+            input_handle(app, e.event.key, furi_get_tick() - e.tick);
+        }
+        cmd_poll(app);
+        uint32_t t = furi_get_tick();
+        if(app->cmd_driven) {
+            last_tick = t;
+        } else {
+            while(t - last_tick >= TICK_MS) {
+                last_tick += TICK_MS;
+                game_tick(app);
+            }
+        }
+        if(t - last_frame >= FRAME_MS) {
+            last_frame = t;
+            // During hit-stop the impact frame is drawn once, then the panel just keeps showing it
+            bool frozen = app->sim.freeze_ticks > 0;
+            if(!frozen || !app->hitstop_shown) app_request_frame(app);
+            app->hitstop_shown = frozen;
+        }
         else furi_delay_ms(2);
     }
 
+    power_log_session(app);
+    cmd_close(app);
+    cue_stop(app);
     gui_remove_view_port(app->gui, app->view_port);
     view_port_free(app->view_port);
+    if(scene_handlers[app->scene].on_exit) scene_handlers[app->scene].on_exit(app);
+    free(app->scene_data);
+    flight_dump(app, FlightExit);
+    io_stop(app);
+    free(app->boss_table);
+    free(app->boss_table_next);
+#ifdef BOX_DIFF
+    free(app->diff);
+#endif
+    plugin_manager_free(app->ai_plugins);
+    furi_mutex_free(app->mutex);
     furi_message_queue_free(app->input_queue);
     furi_record_close(RECORD_GUI);
     free(app);
@@ -0,0 +1,11 @@
+# cmake -DAPP=<exe> -DINPUT=<line> -DEXPECT=<reply> -P cdc_test.cmake
+# Runs one command through the host app's CDC port and compares the reply.
+file(WRITE ${CMAKE_CURRENT_BINARY_DIR}/cdc_test.in "${INPUT}\n")
+execute_process(COMMAND ${APP}
+    INPUT_FILE ${CMAKE_CURRENT_BINARY_DIR}/cdc_test.in
+    OUTPUT_VARIABLE out
+    RESULT_VARIABLE rc
+    TIMEOUT 600)
+if(NOT rc EQUAL 0 OR NOT out STREQUAL EXPECT)
+    message(FATAL_ERROR "${INPUT}: exit ${rc}, got \"${out}\", want \"${EXPECT}\"")
+endif()
@@ -0,0 +1,124 @@
+// The replay corpus and the differential run on a 32-bit target without a 32-bit libc: static,
+// freestanding i386 (long and pointers 4 bytes, as on the M4), Linux syscalls for output. Only
+// the sim, the replay code and the reference core are linked; the rest of the app is dropped
+// with --gc-sections, so the few libc calls they make are all that is provided here.
+#include "../../box_flipper.c"
+
+static uint8_t heap[1 << 20];
+static size_t heap_used;
+
+void* malloc(size_t size) {
+    if(size > sizeof(heap) - heap_used) return NULL;
+    void* p = heap + heap_used;
+    heap_used += (size + 15) & ~(size_t)15;
+    return p;
+}
+
+void free(void* ptr) {
+    UNUSED(ptr);
+}
+
+void* memset(void* dst, int c, size_t n) {
+    uint8_t* d = dst;
+    while(n--) *d++ = (uint8_t)c;
+    return dst;
+}
+
+void* memcpy(void* dst, const void* src, size_t n) {
+    uint8_t* d = dst;
+    const uint8_t* s = src;
+    while(n--) *d++ = *s++;
+    return dst;
+}
+
+void* memmove(void* dst, const void* src, size_t n) {
+    uint8_t* d = dst;
+    const uint8_t* s = src;
+    if(d < s)
+        while(n--) *d++ = *s++;
+    else
+        while(n--) d[n] = s[n];
+    return dst;
+}
+
+int memcmp(const void* a, const void* b, size_t n) {
+    const uint8_t *x = a, *y = b;
+    for(; n; n--, x++, y++)
+        if(*x != *y) return *x - *y;
+    return 0;
+}
+
+// FX_CYCCNT for the profilers; a constant clock keeps them within budget
+uint32_t host_cycles(void) {
+    return 0;
+}
+
+int abs(int v) {
+    return v < 0 ? -v : v;
+}
+
+static void sys_write(const char* s) {
+    size_t n = 0;
+    while(s[n]) n++;
+    long ret = 4; // write(1, s, n)
+    __asm__ volatile("int $0x80" : "+a"(ret) : "b"(1), "c"(s), "d"(n) : "memory");
+}
+
+static __attribute__((noreturn)) void sys_exit(int code) {
+    __asm__ volatile("int $0x80" ::"a"(1), "b"(code)); // exit(code)
+    __builtin_unreachable();
+}
+
+void abort(void) {
+    sys_exit(134);
+}
+
+// A furi_check in the sim lands here through the stub's fprintf
+FILE* stderr;
+int fprintf(FILE* stream, const char* format, ...) {
+    UNUSED(stream);
+    sys_write(format);
+    return 0;
+}
+
+static void put_u32(const char* label, uint32_t v) {
+    char buf[12];
+    char* p = buf + sizeof(buf) - 1;
+    *p = '\0';
+    do
+        *--p = '0' + v % 10;
+    while(v /= 10);
+    sys_write(label);
+    sys_write(p);
+    sys_write("\n");
+}
+
+#define DIFF_RUNS 300
+#define DIFF_TICKS 3000
+
+void _start(void) {
+    _Static_assert(sizeof(long) == 4 && sizeof(void*) == 4, "not an ILP32 target");
+    App* app = malloc(sizeof(App));
+    init_bosses(app);
+    Replay* rp = malloc(sizeof(Replay));
+    rp->c.in = rp->in;
+    uint32_t fails = 0;
+    for(uint32_t i = 0; i < COUNT_OF(replay_golden); i++) {
+        const ReplayGolden* g = &replay_golden[i];
+        replay_gen(&rp->c, g->seed, g->ticks);
+        if(replay_hash(rp, app->bosses, g->hitstop_ticks) != g->hash) fails++;
+    }
+    put_u32("H done ", COUNT_OF(replay_golden));
+    put_u32("H fail ", fails);
+    // D 5 300 3000, at both hitstop settings the goldens use
+    Diff* d = diff_alloc(REPLAY_INPUTS_MAX);
+    uint32_t diverged = 0;
+    for(uint32_t r = 0; r < DIFF_RUNS; r++) {
+        replay_gen(&d->c, 5 + r, DIFF_TICKS);
+        if(diff_run(d, &d->c, app->bosses, 0)) diverged++;
+        if(diff_run(d, &d->c, app->bosses, HITSTOP_FRAMES_DEFAULT * FRAME_MS / TICK_MS)) diverged++;
+    }
+    put_u32("D runs ", DIFF_RUNS * 2);
+    put_u32("D diverged ", diverged);
+    sys_exit(fails || diverged);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <stdarg.h>
+#include <stddef.h>
+
+typedef struct FILE FILE;
+extern FILE* stdout;
+extern FILE* stderr;
+int printf(const char* format, ...);
+int fprintf(FILE* stream, const char* format, ...);
+int snprintf(char* str, size_t size, const char* format, ...);
@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+
+void* malloc(size_t size);
+void* calloc(size_t count, size_t size);
+void* realloc(void* ptr, size_t size);
+void free(void* ptr);
+long strtol(const char* str, char** end, int base);
+unsigned long strtoul(const char* str, char** end, int base);
+int abs(int v);
+int rand(void);
+void srand(unsigned seed);
+void abort(void);
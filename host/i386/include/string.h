@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+
+void* memcpy(void* dst, const void* src, size_t n);
+void* memmove(void* dst, const void* src, size_t n);
+void* memset(void* dst, int c, size_t n);
+int memcmp(const void* a, const void* b, size_t n);
+size_t strlen(const char* str);
+int strcmp(const char* a, const char* b);
+int strncmp(const char* a, const char* b, size_t n);
+char* strchr(const char* str, int c);
+size_t strspn(const char* str, const char* accept);
+size_t strcspn(const char* str, const char* reject);
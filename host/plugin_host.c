@@ -0,0 +1,70 @@
+// Host PluginManager: a plugin is <path>/<name>.so exporting <name>_ep, the symbol fbt would name
+// the entry point after the App's appid. Descriptors are checked like the firmware's loader.
+#define _GNU_SOURCE
+#include <flipper_application/flipper_application.h>
+#include <flipper_application/plugins/plugin_manager.h>
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_PLUGINS_MAX 16
+
+const ElfApiInterface* const firmware_api_interface = NULL;
+
+struct PluginManager {
+    const char* application_id;
+    uint32_t api_version;
+    const void* ep[HOST_PLUGINS_MAX];
+    uint32_t count;
+};
+
+PluginManager* plugin_manager_alloc(const char* application_id, uint32_t api_version, const ElfApiInterface* api_interface) {
+    (void)api_interface;
+    PluginManager* manager = calloc(1, sizeof(PluginManager));
+    manager->application_id = application_id;
+    manager->api_version = api_version;
+    return manager;
+}
+
+void plugin_manager_free(PluginManager* manager) {
+    free(manager);
+}
+
+PluginManagerError plugin_manager_load_all(PluginManager* manager, const char* path) {
+    DIR* dir = opendir(path);
+    if(!dir) return PluginManagerErrorLoaderError;
+    struct dirent* entry;
+    while((entry = readdir(dir)) && manager->count < HOST_PLUGINS_MAX) {
+        size_t len = strlen(entry->d_name);
+        if(len < 4 || strcmp(entry->d_name + len - 3, ".so")) continue;
+        char file[512], symbol[128];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        snprintf(symbol, sizeof(symbol), "%.*s_ep", (int)(len - 3), entry->d_name);
+        void* handle = dlopen(file, RTLD_NOW);
+        if(!handle) {
+            fprintf(stderr, "plugin %s: %s\n", entry->d_name, dlerror());
+            continue;
+        }
+        const FlipperAppPluginDescriptor* (*ep)(void) = (const FlipperAppPluginDescriptor* (*)(void))dlsym(handle, symbol);
+        const FlipperAppPluginDescriptor* desc = ep ? ep() : NULL;
+        if(!desc || strcmp(desc->appid, manager->application_id) || desc->ep_api_version != manager->api_version) {
+            fprintf(stderr, "plugin %s rejected\n", entry->d_name);
+            dlclose(handle);
+            continue;
+        }
+        manager->ep[manager->count++] = desc->entry_point;
+    }
+    closedir(dir);
+    return PluginManagerErrorNone;
+}
+
+uint32_t plugin_manager_get_count(PluginManager* manager) {
+    return manager->count;
+}
+
+const void* plugin_manager_get_ep(PluginManager* manager, uint32_t index) {
+    return manager->ep[index];
+}
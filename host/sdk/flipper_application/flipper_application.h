@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+
+typedef struct {
+    const char* appid;
+    uint32_t ep_api_version;
+    const void* entry_point;
+} FlipperAppPluginDescriptor;
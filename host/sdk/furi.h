@@ -0,0 +1,94 @@
+// Host stand-in for the Flipper SDK: only what box_flipper.c uses, with the firmware's names and
+// signatures. Implemented over pthreads and stdio in sdk_host.c.
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define UNUSED(x) (void)(x)
+#define COUNT_OF(x) (sizeof(x) / sizeof(x[0]))
+
+#define FURI_LOG_E(tag, fmt, ...) fprintf(stderr, "[E][%s] " fmt "\n", tag, ##__VA_ARGS__)
+#define FURI_LOG_W(tag, fmt, ...) fprintf(stderr, "[W][%s] " fmt "\n", tag, ##__VA_ARGS__)
+#define FURI_LOG_I(tag, fmt, ...) fprintf(stderr, "[I][%s] " fmt "\n", tag, ##__VA_ARGS__)
+#define FURI_LOG_D(tag, fmt, ...) fprintf(stderr, "[D][%s] " fmt "\n", tag, ##__VA_ARGS__)
+
+#define furi_check(x)                                 \
+    do {                                              \
+        if(!(x)) {                                    \
+            fprintf(stderr, "furi_check: %s\n", #x); \
+            abort();                                  \
+        }                                             \
+    } while(0)
+#define furi_assert(x) furi_check(x)
+
+#define FuriWaitForever 0xFFFFFFFFU
+
+typedef enum {
+    FuriStatusOk = 0,
+    FuriStatusError = -1,
+    FuriStatusErrorTimeout = -2,
+} FuriStatus;
+
+uint32_t furi_get_tick(void);
+uint32_t furi_kernel_get_tick_frequency(void);
+void furi_delay_ms(uint32_t ms);
+void furi_delay_tick(uint32_t ticks);
+
+void* furi_record_open(const char* name);
+void furi_record_close(const char* name);
+
+typedef struct FuriMessageQueue FuriMessageQueue;
+FuriMessageQueue* furi_message_queue_alloc(uint32_t msg_count, uint32_t msg_size);
+void furi_message_queue_free(FuriMessageQueue* queue);
+FuriStatus furi_message_queue_put(FuriMessageQueue* queue, const void* msg, uint32_t timeout);
+FuriStatus furi_message_queue_get(FuriMessageQueue* queue, void* msg, uint32_t timeout);
+uint32_t furi_message_queue_get_count(FuriMessageQueue* queue);
+
+typedef struct FuriStreamBuffer FuriStreamBuffer;
+FuriStreamBuffer* furi_stream_buffer_alloc(size_t size, size_t trigger_level);
+void furi_stream_buffer_free(FuriStreamBuffer* stream);
+size_t furi_stream_buffer_send(FuriStreamBuffer* stream, const void* data, size_t length, uint32_t timeout);
+size_t furi_stream_buffer_receive(FuriStreamBuffer* stream, void* data, size_t length, uint32_t timeout);
+
+typedef struct FuriThread FuriThread;
+typedef int32_t (*FuriThreadCallback)(void* context);
+typedef enum {
+    FuriThreadPriorityIdle = 0,
+    FuriThreadPriorityLowest = 14,
+    FuriThreadPriorityLow = 15,
+    FuriThreadPriorityNormal = 16,
+    FuriThreadPriorityHigh = 17,
+} FuriThreadPriority;
+FuriThread* furi_thread_alloc_ex(const char* name, uint32_t stack_size, FuriThreadCallback callback, void* context);
+void furi_thread_set_priority(FuriThread* thread, FuriThreadPriority priority);
+void furi_thread_start(FuriThread* thread);
+bool furi_thread_join(FuriThread* thread);
+void furi_thread_free(FuriThread* thread);
+
+typedef struct FuriString FuriString;
+FuriString* furi_string_alloc(void);
+void furi_string_free(FuriString* string);
+const char* furi_string_get_cstr(const FuriString* string);
+size_t furi_string_size(const FuriString* string);
+void furi_string_reset(FuriString* string);
+void furi_string_printf(FuriString* string, const char* format, ...);
+void furi_string_cat_printf(FuriString* string, const char* format, ...);
+
+typedef struct FuriSemaphore FuriSemaphore;
+FuriSemaphore* furi_semaphore_alloc(uint32_t max_count, uint32_t initial_count);
+void furi_semaphore_free(FuriSemaphore* semaphore);
+FuriStatus furi_semaphore_acquire(FuriSemaphore* semaphore, uint32_t timeout);
+FuriStatus furi_semaphore_release(FuriSemaphore* semaphore);
+
+typedef struct FuriMutex FuriMutex;
+typedef enum {
+    FuriMutexTypeNormal,
+    FuriMutexTypeRecursive,
+} FuriMutexType;
+FuriMutex* furi_mutex_alloc(FuriMutexType type);
+void furi_mutex_free(FuriMutex* mutex);
+FuriStatus furi_mutex_acquire(FuriMutex* mutex, uint32_t timeout);
+FuriStatus furi_mutex_release(FuriMutex* mutex);
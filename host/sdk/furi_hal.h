@@ -0,0 +1,26 @@
+#pragma once
+#include <furi.h>
+
+typedef struct FuriHalUsbInterface FuriHalUsbInterface;
+extern FuriHalUsbInterface usb_cdc_dual;
+const FuriHalUsbInterface* furi_hal_usb_get_config(void);
+bool furi_hal_usb_set_config(const FuriHalUsbInterface* interface, void* context);
+void furi_hal_usb_unlock(void);
+
+typedef struct {
+    void (*tx_ep_callback)(void* context);
+    void (*rx_ep_callback)(void* context);
+    void (*state_callback)(void* context, uint8_t state);
+    void (*ctrl_line_callback)(void* context, uint8_t ctrl_lines);
+    void (*config_callback)(void* context, void* config);
+} CdcCallbacks;
+void furi_hal_cdc_set_callbacks(uint8_t if_num, CdcCallbacks* cb, void* context);
+void furi_hal_cdc_send(uint8_t if_num, uint8_t* buf, uint16_t len);
+int32_t furi_hal_cdc_receive(uint8_t if_num, uint8_t* buf, uint16_t max_len);
+
+uint32_t furi_hal_cortex_instructions_per_microsecond(void);
+uint32_t furi_hal_random_get(void);
+
+// Stands in for DWT->CYCCNT in the profilers
+uint32_t host_cycles(void);
+#define FX_CYCCNT host_cycles()
@@ -0,0 +1,6 @@
+#pragma once
+#include <gui/gui.h>
+
+uint8_t* canvas_get_buffer(Canvas* canvas);
+size_t canvas_get_buffer_size(const Canvas* canvas);
+void canvas_frame_set(Canvas* canvas, int32_t offset_x, int32_t offset_y, size_t width, size_t height);
@@ -0,0 +1,4 @@
+#pragma once
+#include <flipper_application/plugins/plugin_manager.h>
+
+extern const ElfApiInterface* const firmware_api_interface;
@@ -0,0 +1,17 @@
+#pragma once
+#include <furi.h>
+
+#define RECORD_NOTIFICATION "notification"
+
+typedef struct NotificationApp NotificationApp;
+typedef struct {
+    int type;
+} NotificationMessage;
+typedef const NotificationMessage* NotificationSequence[];
+
+extern const NotificationMessage message_note_c4, message_note_c5, message_note_e6, message_sound_off;
+extern const NotificationMessage message_vibro_on, message_vibro_off, message_display_backlight_on;
+extern const NotificationMessage message_delay_10, message_delay_25, message_delay_50, message_delay_100,
+    message_delay_250;
+
+void notification_message(NotificationApp* app, const NotificationSequence* sequence);
@@ -0,0 +1,717 @@
+// Host implementation of host/sdk: threads, queues and mutexes on pthreads, the CDC port on
+// stdin/stdout, the SD card under ./appdata, and a canvas that draws into a 128x64 buffer nobody
+// shows. Enough to run the command channel off the device; not a simulator of the firmware.
+#define _GNU_SOURCE
+#include <furi.h>
+#include <furi_hal.h>
+#include <gui/gui.h>
+#include <gui/canvas_i.h>
+#include <notification/notification_messages.h>
+#include <storage/storage.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// KERNEL
+
+static uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint32_t furi_get_tick(void) {
+    static uint64_t t0;
+    if(!t0) t0 = host_ns();
+    return (uint32_t)((host_ns() - t0) / 1000000ull);
+}
+
+uint32_t furi_kernel_get_tick_frequency(void) {
+    return 1000;
+}
+
+// Set once stdin is closed; the app then gets HOST_EOF_DELAYS more sleeps to answer before exit
+#define HOST_EOF_DELAYS 150
+static volatile bool host_eof;
+
+void furi_delay_ms(uint32_t ms) {
+    static uint32_t idle;
+    usleep(ms * 1000);
+    if(host_eof && ++idle > HOST_EOF_DELAYS) {
+        fflush(stdout);
+        _exit(0);
+    }
+}
+
+void furi_delay_tick(uint32_t ticks) {
+    usleep(ticks * 1000);
+}
+
+void* furi_record_open(const char* name) {
+    static int record;
+    UNUSED(name);
+    return &record;
+}
+
+void furi_record_close(const char* name) {
+    UNUSED(name);
+}
+
+uint32_t furi_hal_cortex_instructions_per_microsecond(void) {
+    return 64;
+}
+
+// 64 MHz, like the M4's DWT->CYCCNT
+uint32_t host_cycles(void) {
+    return (uint32_t)(host_ns() * 64 / 1000);
+}
+
+uint32_t furi_hal_random_get(void) {
+    return (uint32_t)rand();
+}
+
+// THREADS
+
+struct FuriThread {
+    pthread_t thread;
+    FuriThreadCallback callback;
+    void* context;
+};
+
+static void* thread_body(void* arg) {
+    FuriThread* thread = arg;
+    thread->callback(thread->context);
+    return NULL;
+}
+
+FuriThread* furi_thread_alloc_ex(const char* name, uint32_t stack_size, FuriThreadCallback callback, void* context) {
+    UNUSED(name);
+    UNUSED(stack_size);
+    FuriThread* thread = calloc(1, sizeof(FuriThread));
+    thread->callback = callback;
+    thread->context = context;
+    return thread;
+}
+
+void furi_thread_set_priority(FuriThread* thread, FuriThreadPriority priority) {
+    UNUSED(thread);
+    UNUSED(priority);
+}
+
+void furi_thread_start(FuriThread* thread) {
+    pthread_create(&thread->thread, NULL, thread_body, thread);
+}
+
+bool furi_thread_join(FuriThread* thread) {
+    pthread_join(thread->thread, NULL);
+    return true;
+}
+
+void furi_thread_free(FuriThread* thread) {
+    free(thread);
+}
+
+struct FuriMutex {
+    pthread_mutex_t mutex;
+};
+
+FuriMutex* furi_mutex_alloc(FuriMutexType type) {
+    FuriMutex* mutex = calloc(1, sizeof(FuriMutex));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    // Normal mutexes are checked so a nested take fails loudly instead of hanging the test
+    pthread_mutexattr_settype(
+        &attr, type == FuriMutexTypeRecursive ? PTHREAD_MUTEX_RECURSIVE : PTHREAD_MUTEX_ERRORCHECK);
+    pthread_mutex_init(&mutex->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return mutex;
+}
+
+void furi_mutex_free(FuriMutex* mutex) {
+    pthread_mutex_destroy(&mutex->mutex);
+    free(mutex);
+}
+
+FuriStatus furi_mutex_acquire(FuriMutex* mutex, uint32_t timeout) {
+    UNUSED(timeout);
+    furi_check(pthread_mutex_lock(&mutex->mutex) == 0);
+    return FuriStatusOk;
+}
+
+FuriStatus furi_mutex_release(FuriMutex* mutex) {
+    furi_check(pthread_mutex_unlock(&mutex->mutex) == 0);
+    return FuriStatusOk;
+}
+
+struct FuriSemaphore {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t count, max;
+};
+
+FuriSemaphore* furi_semaphore_alloc(uint32_t max_count, uint32_t initial_count) {
+    FuriSemaphore* sem = calloc(1, sizeof(FuriSemaphore));
+    pthread_mutex_init(&sem->mutex, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = initial_count;
+    sem->max = max_count;
+    return sem;
+}
+
+void furi_semaphore_free(FuriSemaphore* sem) {
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->mutex);
+    free(sem);
+}
+
+FuriStatus furi_semaphore_acquire(FuriSemaphore* sem, uint32_t timeout) {
+    uint32_t waited = 0;
+    pthread_mutex_lock(&sem->mutex);
+    while(!sem->count) {
+        if(timeout != FuriWaitForever && waited++ >= timeout) {
+            pthread_mutex_unlock(&sem->mutex);
+            return FuriStatusErrorTimeout;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000;
+        if(ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&sem->cond, &sem->mutex, &ts);
+    }
+    sem->count--;
+    pthread_mutex_unlock(&sem->mutex);
+    return FuriStatusOk;
+}
+
+FuriStatus furi_semaphore_release(FuriSemaphore* sem) {
+    pthread_mutex_lock(&sem->mutex);
+    FuriStatus status = sem->count < sem->max ? FuriStatusOk : FuriStatusError;
+    if(status == FuriStatusOk) sem->count++;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->mutex);
+    return status;
+}
+
+// QUEUES
+
+struct FuriMessageQueue {
+    pthread_mutex_t mutex;
+    uint8_t* buf;
+    uint32_t capacity, size, head, count;
+};
+
+FuriMessageQueue* furi_message_queue_alloc(uint32_t msg_count, uint32_t msg_size) {
+    FuriMessageQueue* queue = calloc(1, sizeof(FuriMessageQueue));
+    pthread_mutex_init(&queue->mutex, NULL);
+    queue->buf = malloc(msg_count * msg_size);
+    queue->capacity = msg_count;
+    queue->size = msg_size;
+    return queue;
+}
+
+void furi_message_queue_free(FuriMessageQueue* queue) {
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->buf);
+    free(queue);
+}
+
+// Timeouts are counted in 1 ms polls, as coarse as the firmware's tick
+FuriStatus furi_message_queue_put(FuriMessageQueue* queue, const void* msg, uint32_t timeout) {
+    for(uint32_t waited = 0;; waited++) {
+        pthread_mutex_lock(&queue->mutex);
+        if(queue->count < queue->capacity) {
+            uint32_t slot = (queue->head + queue->count) % queue->capacity;
+            memcpy(queue->buf + slot * queue->size, msg, queue->size);
+            queue->count++;
+            pthread_mutex_unlock(&queue->mutex);
+            return FuriStatusOk;
+        }
+        pthread_mutex_unlock(&queue->mutex);
+        if(timeout != FuriWaitForever && waited >= timeout) return FuriStatusErrorTimeout;
+        usleep(1000);
+    }
+}
+
+FuriStatus furi_message_queue_get(FuriMessageQueue* queue, void* msg, uint32_t timeout) {
+    for(uint32_t waited = 0;; waited++) {
+        pthread_mutex_lock(&queue->mutex);
+        if(queue->count) {
+            memcpy(msg, queue->buf + queue->head * queue->size, queue->size);
+            queue->head = (queue->head + 1) % queue->capacity;
+            queue->count--;
+            pthread_mutex_unlock(&queue->mutex);
+            return FuriStatusOk;
+        }
+        pthread_mutex_unlock(&queue->mutex);
+        if(timeout != FuriWaitForever && waited >= timeout) return FuriStatusErrorTimeout;
+        usleep(1000);
+    }
+}
+
+uint32_t furi_message_queue_get_count(FuriMessageQueue* queue) {
+    pthread_mutex_lock(&queue->mutex);
+    uint32_t count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+struct FuriStreamBuffer {
+    pthread_mutex_t mutex;
+    uint8_t* buf;
+    size_t capacity, head, count;
+};
+
+FuriStreamBuffer* furi_stream_buffer_alloc(size_t size, size_t trigger_level) {
+    UNUSED(trigger_level);
+    FuriStreamBuffer* stream = calloc(1, sizeof(FuriStreamBuffer));
+    pthread_mutex_init(&stream->mutex, NULL);
+    stream->buf = malloc(size);
+    stream->capacity = size;
+    return stream;
+}
+
+void furi_stream_buffer_free(FuriStreamBuffer* stream) {
+    pthread_mutex_destroy(&stream->mutex);
+    free(stream->buf);
+    free(stream);
+}
+
+size_t furi_stream_buffer_send(FuriStreamBuffer* stream, const void* data, size_t length, uint32_t timeout) {
+    const uint8_t* bytes = data;
+    size_t sent = 0;
+    for(uint32_t waited = 0;; waited++) {
+        pthread_mutex_lock(&stream->mutex);
+        for(; sent < length && stream->count < stream->capacity; sent++) {
+            stream->buf[(stream->head + stream->count) % stream->capacity] = bytes[sent];
+            stream->count++;
+        }
+        pthread_mutex_unlock(&stream->mutex);
+        if(sent == length || (timeout != FuriWaitForever && waited >= timeout)) return sent;
+        usleep(1000);
+    }
+}
+
+size_t furi_stream_buffer_receive(FuriStreamBuffer* stream, void* data, size_t length, uint32_t timeout) {
+    UNUSED(timeout);
+    uint8_t* bytes = data;
+    size_t got = 0;
+    pthread_mutex_lock(&stream->mutex);
+    for(; got < length && stream->count; got++) {
+        bytes[got] = stream->buf[stream->head];
+        stream->head = (stream->head + 1) % stream->capacity;
+        stream->count--;
+    }
+    pthread_mutex_unlock(&stream->mutex);
+    return got;
+}
+
+// STRINGS
+
+struct FuriString {
+    char* str;
+    size_t size;
+};
+
+FuriString* furi_string_alloc(void) {
+    FuriString* string = calloc(1, sizeof(FuriString));
+    string->str = calloc(1, 1);
+    return string;
+}
+
+void furi_string_free(FuriString* string) {
+    free(string->str);
+    free(string);
+}
+
+const char* furi_string_get_cstr(const FuriString* string) {
+    return string->str;
+}
+
+size_t furi_string_size(const FuriString* string) {
+    return string->size;
+}
+
+void furi_string_reset(FuriString* string) {
+    string->str[0] = '\0';
+    string->size = 0;
+}
+
+static void string_vcat(FuriString* string, const char* format, va_list args) {
+    char* text;
+    int n = vasprintf(&text, format, args);
+    furi_check(n >= 0);
+    string->str = realloc(string->str, string->size + n + 1);
+    memcpy(string->str + string->size, text, n + 1);
+    string->size += n;
+    free(text);
+}
+
+void furi_string_printf(FuriString* string, const char* format, ...) {
+    va_list args;
+    furi_string_reset(string);
+    va_start(args, format);
+    string_vcat(string, format, args);
+    va_end(args);
+}
+
+void furi_string_cat_printf(FuriString* string, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    string_vcat(string, format, args);
+    va_end(args);
+}
+
+// GUI
+
+#define HOST_W 128
+#define HOST_H 64
+
+struct Canvas {
+    uint8_t fb[HOST_W * HOST_H / 8];
+    Color color;
+    int32_t ox, oy;
+};
+
+static Canvas host_canvas;
+
+static void canvas_px(Canvas* c, int32_t x, int32_t y) {
+    x += c->ox;
+    y += c->oy;
+    if(x < 0 || y < 0 || x >= HOST_W || y >= HOST_H) return;
+    uint8_t mask = 1 << (y & 7);
+    uint8_t* b = &c->fb[(y >> 3) * HOST_W + x];
+    if(c->color == ColorBlack)
+        *b |= mask;
+    else if(c->color == ColorWhite)
+        *b &= ~mask;
+    else
+        *b ^= mask;
+}
+
+void canvas_clear(Canvas* c) {
+    memset(c->fb, 0, sizeof(c->fb));
+    c->color = ColorBlack;
+}
+
+void canvas_set_font(Canvas* c, Font font) {
+    UNUSED(c);
+    UNUSED(font);
+}
+
+void canvas_set_color(Canvas* c, Color color) {
+    c->color = color;
+}
+
+void canvas_invert_color(Canvas* c) {
+    c->color = c->color == ColorBlack ? ColorWhite : ColorBlack;
+}
+
+// Text is a bar per glyph: enough to exercise the draw paths
+void canvas_draw_str(Canvas* c, int32_t x, int32_t y, const char* str) {
+    for(int32_t i = 0; str[i]; i++)
+        for(int32_t k = 0; k < 5; k++) canvas_px(c, x + i * 6 + k, y - 3);
+}
+
+void canvas_draw_str_aligned(Canvas* c, int32_t x, int32_t y, Align horizontal, Align vertical, const char* str) {
+    UNUSED(horizontal);
+    UNUSED(vertical);
+    canvas_draw_str(c, x - (int32_t)strlen(str) * 3, y, str);
+}
+
+void canvas_draw_box(Canvas* c, int32_t x, int32_t y, size_t width, size_t height) {
+    for(size_t j = 0; j < height; j++)
+        for(size_t i = 0; i < width; i++) canvas_px(c, x + i, y + j);
+}
+
+void canvas_draw_frame(Canvas* c, int32_t x, int32_t y, size_t width, size_t height) {
+    for(size_t i = 0; i < width; i++) {
+        canvas_px(c, x + i, y);
+        canvas_px(c, x + i, y + height - 1);
+    }
+    for(size_t j = 0; j < height; j++) {
+        canvas_px(c, x, y + j);
+        canvas_px(c, x + width - 1, y + j);
+    }
+}
+
+void canvas_draw_line(Canvas* c, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    int32_t dx = abs(x2 - x1), dy = abs(y2 - y1), n = dx > dy ? dx : dy;
+    for(int32_t i = 0; i <= n; i++)
+        canvas_px(c, x1 + (n ? (x2 - x1) * i / n : 0), y1 + (n ? (y2 - y1) * i / n : 0));
+}
+
+void canvas_draw_dot(Canvas* c, int32_t x, int32_t y) {
+    canvas_px(c, x, y);
+}
+
+void canvas_draw_xbm(Canvas* c, int32_t x, int32_t y, size_t width, size_t height, const uint8_t* bitmap) {
+    size_t stride = (width + 7) / 8;
+    for(size_t j = 0; j < height; j++)
+        for(size_t i = 0; i < width; i++)
+            if(bitmap[j * stride + i / 8] & (1 << (i & 7))) canvas_px(c, x + i, y + j);
+}
+
+uint8_t* canvas_get_buffer(Canvas* c) {
+    return c->fb;
+}
+
+size_t canvas_get_buffer_size(const Canvas* c) {
+    return sizeof(c->fb);
+}
+
+void canvas_frame_set(Canvas* c, int32_t offset_x, int32_t offset_y, size_t width, size_t height) {
+    UNUSED(width);
+    UNUSED(height);
+    c->ox = offset_x;
+    c->oy = offset_y;
+}
+
+struct ViewPort {
+    ViewPortDrawCallback draw;
+    void* draw_ctx;
+    ViewPortInputCallback input;
+    void* input_ctx;
+};
+
+ViewPort* view_port_alloc(void) {
+    return calloc(1, sizeof(ViewPort));
+}
+
+void view_port_free(ViewPort* view_port) {
+    free(view_port);
+}
+
+void view_port_draw_callback_set(ViewPort* view_port, ViewPortDrawCallback callback, void* context) {
+    view_port->draw = callback;
+    view_port->draw_ctx = context;
+}
+
+void view_port_input_callback_set(ViewPort* view_port, ViewPortInputCallback callback, void* context) {
+    view_port->input = callback;
+    view_port->input_ctx = context;
+}
+
+// Draws inline on the caller, where the firmware would queue it to the GUI thread
+void view_port_update(ViewPort* view_port) {
+    if(view_port->draw) view_port->draw(&host_canvas, view_port->draw_ctx);
+}
+
+void gui_add_view_port(Gui* gui, ViewPort* view_port, GuiLayer layer) {
+    UNUSED(gui);
+    UNUSED(view_port);
+    UNUSED(layer);
+}
+
+void gui_remove_view_port(Gui* gui, ViewPort* view_port) {
+    UNUSED(gui);
+    UNUSED(view_port);
+}
+
+const NotificationMessage message_note_c4, message_note_c5, message_note_e6, message_sound_off;
+const NotificationMessage message_vibro_on, message_vibro_off, message_display_backlight_on;
+const NotificationMessage message_delay_10, message_delay_25, message_delay_50, message_delay_100,
+    message_delay_250;
+
+void notification_message(NotificationApp* app, const NotificationSequence* sequence) {
+    UNUSED(app);
+    UNUSED(sequence);
+}
+
+// CDC
+// stdin is the host's side of the port: each read() is handed over as one rx callback, and the
+// app's furi_hal_cdc_receive drains it. Replies go straight to stdout and complete at once.
+
+struct FuriHalUsbInterface {
+    int unused;
+};
+FuriHalUsbInterface usb_cdc_dual;
+
+static CdcCallbacks* cdc_cb;
+static void* cdc_ctx;
+static pthread_mutex_t cdc_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cdc_drained = PTHREAD_COND_INITIALIZER;
+static uint8_t cdc_rx[64];
+static size_t cdc_rx_len;
+
+const FuriHalUsbInterface* furi_hal_usb_get_config(void) {
+    return NULL;
+}
+
+bool furi_hal_usb_set_config(const FuriHalUsbInterface* interface, void* context) {
+    UNUSED(interface);
+    UNUSED(context);
+    return true;
+}
+
+void furi_hal_usb_unlock(void) {
+}
+
+static void* cdc_reader(void* arg) {
+    UNUSED(arg);
+    uint8_t buf[sizeof(cdc_rx)];
+    ssize_t n;
+    while((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+        pthread_mutex_lock(&cdc_mutex);
+        while(cdc_rx_len) pthread_cond_wait(&cdc_drained, &cdc_mutex);
+        memcpy(cdc_rx, buf, n);
+        cdc_rx_len = n;
+        pthread_mutex_unlock(&cdc_mutex);
+        if(cdc_cb && cdc_cb->rx_ep_callback) cdc_cb->rx_ep_callback(cdc_ctx);
+    }
+    host_eof = true;
+    return NULL;
+}
+
+void furi_hal_cdc_set_callbacks(uint8_t if_num, CdcCallbacks* cb, void* context) {
+    static bool started;
+    UNUSED(if_num);
+    cdc_cb = cb;
+    cdc_ctx = context;
+    if(cb && !started) {
+        pthread_t thread;
+        started = true;
+        pthread_create(&thread, NULL, cdc_reader, NULL);
+    }
+}
+
+void furi_hal_cdc_send(uint8_t if_num, uint8_t* buf, uint16_t len) {
+    UNUSED(if_num);
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+    if(cdc_cb && cdc_cb->tx_ep_callback) cdc_cb->tx_ep_callback(cdc_ctx);
+}
+
+int32_t furi_hal_cdc_receive(uint8_t if_num, uint8_t* buf, uint16_t max_len) {
+    UNUSED(if_num);
+    pthread_mutex_lock(&cdc_mutex);
+    size_t n = cdc_rx_len < max_len ? cdc_rx_len : max_len;
+    memcpy(buf, cdc_rx, n);
+    memmove(cdc_rx, cdc_rx + n, cdc_rx_len - n);
+    cdc_rx_len -= n;
+    if(!cdc_rx_len) pthread_cond_signal(&cdc_drained);
+    pthread_mutex_unlock(&cdc_mutex);
+    return (int32_t)n;
+}
+
+// STORAGE
+
+struct File {
+    FILE* f;
+};
+
+File* storage_file_alloc(Storage* storage) {
+    UNUSED(storage);
+    mkdir(APP_DATA_PATH(""), 0755);
+    return calloc(1, sizeof(File));
+}
+
+void storage_file_free(File* file) {
+    if(file->f) fclose(file->f);
+    free(file);
+}
+
+bool storage_file_open(File* file, const char* path, FS_AccessMode access_mode, FS_OpenMode open_mode) {
+    const char* mode = "r+b";
+    if(access_mode == FSAM_READ)
+        mode = "rb";
+    else if(open_mode == FSOM_CREATE_ALWAYS)
+        mode = "wb";
+    else if(open_mode == FSOM_OPEN_APPEND)
+        mode = "ab";
+    else if(open_mode == FSOM_CREATE_NEW && access(path, F_OK) == 0)
+        return false;
+    file->f = fopen(path, mode);
+    if(!file->f && open_mode != FSOM_OPEN_EXISTING && access_mode != FSAM_READ) file->f = fopen(path, "w+b");
+    return file->f != NULL;
+}
+
+bool storage_file_close(File* file) {
+    if(file->f) fclose(file->f);
+    file->f = NULL;
+    return true;
+}
+
+bool storage_file_is_open(File* file) {
+    return file->f != NULL;
+}
+
+size_t storage_file_read(File* file, void* buff, size_t bytes_to_read) {
+    return file->f ? fread(buff, 1, bytes_to_read, file->f) : 0;
+}
+
+size_t storage_file_write(File* file, const void* buff, size_t bytes_to_write) {
+    return file->f ? fwrite(buff, 1, bytes_to_write, file->f) : 0;
+}
+
+bool storage_file_seek(File* file, uint32_t offset, bool from_start) {
+    return file->f && fseek(file->f, offset, from_start ? SEEK_SET : SEEK_CUR) == 0;
+}
+
+uint64_t storage_file_tell(File* file) {
+    return file->f ? (uint64_t)ftell(file->f) : 0;
+}
+
+uint64_t storage_file_size(File* file) {
+    struct stat st;
+    if(!file->f) return 0;
+    fflush(file->f);
+    return fstat(fileno(file->f), &st) ? 0 : (uint64_t)st.st_size;
+}
+
+bool storage_file_eof(File* file) {
+    return !file->f || feof(file->f);
+}
+
+bool storage_file_sync(File* file) {
+    return file->f && fflush(file->f) == 0;
+}
+
+FS_Error storage_common_stat(Storage* storage, const char* path, FileInfo* fileinfo) {
+    struct stat st;
+    UNUSED(storage);
+    if(stat(path, &st)) return FSE_NOT_EXIST;
+    if(fileinfo) {
+        fileinfo->flags = 0;
+        fileinfo->size = st.st_size;
+        fileinfo->modification_time = (uint32_t)st.st_mtime;
+    }
+    return FSE_OK;
+}
+
+FS_Error storage_common_timestamp(Storage* storage, const char* path, uint32_t* timestamp) {
+    struct stat st;
+    UNUSED(storage);
+    if(stat(path, &st)) return FSE_NOT_EXIST;
+    *timestamp = (uint32_t)st.st_mtime;
+    return FSE_OK;
+}
+
+FS_Error storage_common_remove(Storage* storage, const char* path) {
+    UNUSED(storage);
+    return remove(path) ? FSE_NOT_EXIST : FSE_OK;
+}
+
+FS_Error storage_common_rename(Storage* storage, const char* old_path, const char* new_path) {
+    UNUSED(storage);
+    return rename(old_path, new_path) ? FSE_NOT_EXIST : FSE_OK;
+}
+
+bool storage_simply_mkdir(Storage* storage, const char* path) {
+    UNUSED(storage);
+    return mkdir(path, 0755) == 0 || access(path, F_OK) == 0;
+}
+
+// ENTRY
+
+extern int32_t box_flipper_app(void* p);
+
+int main(void) {
+    return box_flipper_app(NULL);
+}